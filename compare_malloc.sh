@@ -18,7 +18,7 @@
 #      Filename: compare_malloc.sh                                             #
 #      By: espadara <espadara@pirate.capn.gg>                                  #
 #      Created: 2025/11/13 22:53:32 by espadara                                #
-#      Updated: 2025/11/13 22:56:38 by espadara                                #
+#      Updated: 2026/10/17 19:31:14 by espadara                                #
 #                                                                              #
 # ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; #
 
@@ -29,14 +29,10 @@
 echo "🐙 Comparing Krakenlib malloc vs System malloc"
 echo ""
 
-# Test with system malloc
-echo "Testing with SYSTEM malloc..."
-gcc -O2 -I includes tests/malloc_bench_only.c -lm -o bench_system
-./bench_system
+# One binary runs every scenario on sea_malloc and on glibc malloc,
+# each in a fresh process (options: -q quick, -t max threads)
+make -s all > /dev/null || exit 1
+gcc -O2 -I includes tests/malloc_bench_only.c krakenlib.a -lbsd -lm -lpthread -o bench_compare || exit 1
+./bench_compare "$@"
 
-echo ""
-echo "Testing with KRAKENLIB malloc..."
-gcc -O2 -I includes tests/malloc_bench_only.c krakenlib.a -lbsd -lm -o bench_kraken
-./bench_kraken
-
-rm bench_system bench_kraken
+rm bench_compare
@@ -18,7 +18,7 @@
 /*      Filename: sealib.h                                                    */
 /*      By: espadara <espadara@pirate.capn.gg>                                */
 /*      Created: 2025/08/23 15:35:18 by espadara                              */
-/*      Updated: 2025/11/27 22:07:47 by espadara                              */
+/*      Updated: 2026/10/17 18:55:18 by espadara                              */
 /*                                                                            */
 /* ************************************************************************** */
 
@@ -112,6 +112,7 @@ t_mem	*sea_arena_init(size_t size);
 void	*sea_arena_alloc(t_mem *arena, size_t size);
 void	sea_arena_free(t_mem *arena);
 void	*sea_memcpy_fast(void *dest, const void *src, size_t n);
+void	*sea_bzero_fast(void *s, size_t n);
 
 /* CONVERSIONS */
 int	sea_atoi(const char *nptr);
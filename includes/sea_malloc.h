@@ -1,142 +1,1025 @@
-/* ************************************************************************** */
-/*                                                                            */
-/*                        ______                                              */
-/*                     .-"      "-.                                           */
-/*                    /            \                                          */
-/*        _          |              |          _                              */
-/*       ( \         |,  .-.  .-.  ,|         / )                             */
-/*        > "=._     | )(__/  \__)( |     _.=" <                              */
-/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
-/*              "=._ (_     ^^     _)"_.="                                    */
-/*                  "=\__|IIIIII|__/="                                        */
-/*                 _.="| \IIIIII/ |"=._                                       */
-/*       _     _.="_.="\          /"=._"=._     _                             */
-/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
-/*       > _.="                            "=._ <                             */
-/*      (_/                                    \_)                            */
-/*                                                                            */
-/*      Filename: malloc.h                                                    */
-/*      By: espadara <espadara@pirate.capn.gg>                                */
-/*      Created: 2025/11/11 22:35:26 by espadara                              */
-/*      Updated: 2025/11/23 17:48:52 by espadara                              */
-/*                                                                            */
-/* ************************************************************************** */
-
-#ifndef MALLOC_H
-#define MALLOC_H
-
-/*
-** ---------- INCLUDES ----------
-*/
-#include <fcntl.h>
-#include "sea_core.h"
-#include "sea_printf.h"
-#include <unistd.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <stdlib.h>
-#include <stdbool.h>
-#include <stddef.h>
-#include <limits.h>
-#include <sys/mman.h>
-#include <stdint.h>
-#include <pthread.h>
-
-/*
-** ---------- SIZE THESHOLDS ----------
-*/
-
-# define PAGE_SIZE       4096
-
-/* ** 1. TINY Definition
-** Range: 1 to 128 bytes (n = 128)
-** Zone Size: Must hold 100 blocks. 128 * 100 = 12800.
-** Aligned to Page: 16384 bytes (4 pages)
-*/
-
-# define TINY_BLOCK_MAX  128
-# define TINY_ZONE_SIZE  16384
-
-/* ** 2. SMALL Definition
-** Range: 129 to 1024 bytes (m = 1024)
-** Zone Size: Must hold 100 blocks. 1024 * 100 = 102400.
-** Aligned to Page: 106496 bytes (26 pages)
-*/
-
-# define SMALL_BLOCK_MAX 8192
-# define SMALL_ZONE_SIZE (1024 * 1024)
-
-/*
-** Alignment: Minimum block size (16 bytes for 128-bit SIMD safety) = ez memfastcpy
-*/
-
-# define MIN_ALIGNMENT   16
-
-/* ** Size Classes:
-** We don't just dump everything in a zone. We segregate by size.
-** Tiny: 16, 32, 48, ... 128 (8 classes)
-** Small: 144, 160, ... 1024 (Many classes)
-*/
-# define MAX_TINY_CLASSES (TINY_BLOCK_MAX / MIN_ALIGNMENT)
-# define MAX_SMALL_CLASSES (SMALL_BLOCK_MAX / MIN_ALIGNMENT)
-
-# define CACHE_SIZE 4
-
-/*
-** ---------- STRUCTS ----------
-*/
-
-/* ** The Bitmap:
-    ** 0 = Free, 1 = Used.
-    ** Tiny Zone (16KB) / Min Block (16B) = 1024 blocks max.
-    ** 1024 bits / 64 bits per int = 16 integers.
-*/
-
-//This structure sits at the VERY BEGINNING of every mmap'd zone (N or M bytes).
-typedef struct	s_slab
-{
-    struct s_slab *next;
-    struct s_slab *prev;
-
-    size_t block_size;
-    size_t total_blocks;
-    size_t free_count;
-
-    uint64_t bitmap[16];
-}	t_slab;
-
-
-/* ** t_heap: The Global Manager
-** Instead of one list, we have an array of lists.
-** request 30 bytes -> round to 32 -> go to index 1 -> O(1) lookup.
-** large is still a linked liste
-*/
-typedef struct s_heap
-{
-    t_slab *tiny[MAX_TINY_CLASSES];
-    t_slab *small[MAX_SMALL_CLASSES];
-    t_slab *large;
-    t_slab *cache_large;
-    size_t cache_count;
-}	t_heap;
-
-/*
-** ---------- GLOBALS -------------
-*/
-extern t_heap g_heap;
-extern pthread_mutex_t g_malloc_mutex;
-
-/*
-** ---------- PROTOTYPES ----------
-*/
-void	*sea_malloc(size_t size);
-void	sea_free(void *ptr);
-void	*sea_realloc(void *ptr, size_t size);
-void	*sea_calloc(size_t count, size_t size);
-
-/* Helper functions */
-void	show_alloc_mem(void);
-void	show_alloc_mem_ex(void *ptr);
-t_slab	*find_slab_by_ptr(void *ptr, int *type_out);
-
-#endif
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: malloc.h                                                    */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2025/11/11 22:35:26 by espadara                              */
+/*      Updated: 2026/10/17 21:16:24 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_H
+#define MALLOC_H
+
+/*
+** ---------- INCLUDES ----------
+*/
+#include <fcntl.h>
+#include "sea_core.h"
+#include "sea_printf.h"
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+** ---------- SIZE THESHOLDS ----------
+*/
+
+# define PAGE_SIZE       4096
+
+/* ** 1. TINY Definition
+** Range: 1 to 128 bytes (n = 128)
+** TINY_ZONE_SIZE is the smallest zone we ever map (4 pages).
+** The constants of this section are the compile-time bounds and
+** defaults; what the allocator goes by is g_conf (see Tuning below).
+*/
+
+# define TINY_BLOCK_MAX  128
+# define TINY_ZONE_SIZE  16384
+
+/* ** 2. SMALL Definition
+** Range: 129 to 8192 bytes
+** SMALL_ZONE_SIZE is the largest zone we ever map.
+** Zones are sized per class (see class_zone_size) so the slab bitmap
+** (SLAB_MAX_BLOCKS bits) covers the whole zone: 160B blocks get a
+** 160KB zone, not a 1MB zone with 850KB nobody can reach.
+*/
+
+# define SMALL_BLOCK_MAX 8192
+# define SMALL_ZONE_SIZE (1024 * 1024)
+
+/* ** 3. MEDIUM Definition
+** Range: 8193 to 512K bytes
+** Page runs carved out of 4MB chunks (mapped aligned to their size).
+** Free runs sit in bins by exact page count (1..128), plus one bin for
+** anything longer, and coalesce with their neighbours on free.
+** Up to MEDIUM_KEEP_CHUNKS fully free chunks stay mapped; any more stay
+** until idle for decay_ms, so a burst that frees a few chunks and maps
+** them again moments later doesn't munmap / mmap them every time.
+** Run descriptors come from a pool grown MEDIUM_DESC_MAP at a time.
+*/
+
+# define MEDIUM_BLOCK_MAX   (512 * 1024)
+# define MEDIUM_CHUNK_SIZE  (4 * 1024 * 1024)
+# define MEDIUM_CHUNK_PAGES (MEDIUM_CHUNK_SIZE / PAGE_SIZE)
+# define MEDIUM_BINS        (MEDIUM_BLOCK_MAX / PAGE_SIZE + 1)
+# define MEDIUM_KEEP_CHUNKS 1
+# define MEDIUM_DESC_MAP    (64 * 1024)
+
+/*
+** Alignment: Minimum block size (16 bytes for 128-bit SIMD safety) = ez memfastcpy
+*/
+
+# define MIN_ALIGNMENT   16
+
+/* ** Size Classes:
+** We don't just dump everything in a zone. We segregate by size.
+** Tiny: 16, 32, 48, ... 128 (8 classes, 16 byte steps)
+** Small: 4 classes per doubling (jemalloc style), worst case 20% slack
+**   160, 192, 224, 256, 320, 384, 448, 512, ... 7168, 8192 (24 classes)
+** Class indices are global: g_heap.small[] keeps the tiny slots unused.
+*/
+# define MAX_TINY_CLASSES (TINY_BLOCK_MAX / MIN_ALIGNMENT)
+# define NUM_SIZE_CLASSES (MAX_TINY_CLASSES + 24)
+# define MAX_SMALL_CLASSES NUM_SIZE_CLASSES
+
+/* 16 bitmap words * 64 */
+# define SLAB_MAX_BLOCKS 1024
+
+/* ** Slab colouring:
+** Zones are page aligned, so block i of every slab of a class would sit
+** at the same page offset and fight for the same L1 sets. Each new slab
+** shifts its blocks by a colour taken round-robin (in SLAB_COLOUR_STEP,
+** or class alignment, steps) out of the zone's tail, which is wasted
+** anyway: up to SLAB_COLOUR_MAX bytes, never a block less.
+*/
+# define SLAB_COLOUR_STEP 64
+# define SLAB_COLOUR_MAX  PAGE_SIZE
+
+/* ** LARGE cache:
+** Freed LARGE mappings are kept in log2 buckets of their mapping size
+** (bucket 0 = [512KB, 1MB)) and served best-fit. The cache is bounded by
+** bytes, not entries: inserting past the budget (large_cache) evicts the
+** oldest entries, and a mapping bigger than half of it is never cached.
+** A hit with more than 1/8 slack is split (tail cached again) or trimmed.
+** Idle entries decay like empty slabs (madvise, then munmap).
+*/
+# define LARGE_CACHE_BYTES     (64 * 1024 * 1024)
+# define LARGE_CACHE_MIN_SHIFT 19
+# define LARGE_CACHE_BUCKETS   16
+
+/* ** calloc on a recycled LARGE block: ranges of at least this many bytes
+** are dropped with MADV_DONTNEED (zero on next touch) instead of cleared.
+*/
+# define LARGE_ZERO_MADVISE (256 * 1024)
+
+/* ** Empty slab retention:
+** A slab whose last block is freed is kept (up to SLAB_KEEP_EMPTY per
+** class) instead of being munmap'd on the spot. Once it has been idle
+** SLAB_DECAY_MS its block pages are madvise'd back (MADV_FREE), after
+** 2 * SLAB_DECAY_MS the zone is unmapped for good.
+*/
+# define SLAB_KEEP_EMPTY 2
+# define SLAB_DECAY_MS   1000
+
+/* ** Thread Cache (tcache):
+** Every thread keeps a LIFO of freed blocks per size class up to
+** TCACHE_MAX_SIZE. malloc/free on a warm bin never take a lock.
+** Blocks sitting in a tcache are still marked used in their slab bitmap;
+** bins are refilled TCACHE_BATCH blocks at a time under the class lock
+** and drained as one chain onto the remote list.
+*/
+# define TCACHE_MAX_SIZE 1024
+# define TCACHE_CLASSES  20 // size_to_class(TCACHE_MAX_SIZE) + 1
+# define TCACHE_BIN_MAX  32
+# define TCACHE_BATCH    16
+# define TCACHE_BIN_LIMIT   1024
+# define TCACHE_BATCH_LIMIT 64
+
+/* ** Page Map:
+** Two level radix tree: page number -> owning slab.
+** TINY/SMALL zones register every page; LARGE blocks only their first
+** page, which holds both the header and the user pointer (slab + 1);
+** MEDIUM runs their first page, pointing at the run descriptor.
+** 48 bit address space, 4K pages = 36 bit page number, split 18 / 18.
+** Root lives in .bss (untouched = no RSS), leaves are mmap'd on demand.
+*/
+# define PAGE_SHIFT         12
+# define PAGEMAP_LEAF_BITS  18
+# define PAGEMAP_ROOT_BITS  (48 - PAGE_SHIFT - PAGEMAP_LEAF_BITS)
+
+/* ** Heap profiler (off until sea_malloc_prof_start):
+** Every thread counts allocated bytes down from an exponentially
+** distributed interval of mean rate bytes; the allocation that crosses
+** zero is sampled: its backtrace is interned in a table of stacks and
+** the pointer kept in a table of live samples until sea_free drops it.
+** While off, the countdown is only re-armed every PROF_IDLE_BYTES.
+** A sample costs about a microsecond (backtrace), so the default rate
+** keeps even a malloc-only loop around half a percent slower.
+** Tables are fixed size (filled up to 3/4, then sampling skips).
+*/
+# define PROF_DEFAULT_RATE (2 * 1024 * 1024)
+# define PROF_IDLE_BYTES   (1024 * 1024)
+# define PROF_DEPTH        32
+# define PROF_SKIP         2  // prof_sample and the allocator entry point
+# define PROF_STACKS       4096
+# define PROF_SAMPLES      65536
+
+/* ** Allocation trace (off until sea_malloc_trace_start, or from startup
+** with KRAKEN_MALLOC_TRACE=<file> in the environment, "%p" -> pid):
+** sea_malloc, sea_free, sea_realloc, sea_calloc and sea_aligned_alloc
+** (batch and sized variants included) append an event to their thread's
+** ring of TRACE_RING_EVENTS without a lock. A full ring is written out
+** by its own thread; the rest at thread exit, sea_malloc_trace_stop and
+** exit. The file is a t_trace_header, then t_trace_events (in order per
+** thread); tests/malloc_replay.c replays it. While off: one load a call.
+*/
+# define TRACE_RING_EVENTS 8192
+# define TRACE_MAGIC       "KRKTRACE"
+# define TRACE_VERSION     1
+# define TRACE_ENV         "KRAKEN_MALLOC_TRACE"
+# define TRACE_MALLOC      1
+# define TRACE_FREE        2
+# define TRACE_REALLOC     3  // old = block passed in
+# define TRACE_CALLOC      4  // size = count * size
+# define TRACE_ALIGNED     5  // old = alignment
+
+/* ** Explicit heaps (sea_heap_create):
+** Slabs of their own, tagged with the heap's id (1 .. SEA_HEAPS_MAX - 1,
+** 0 = g_heap), so sea_free finds their lists. Up to medium_max a heap
+** block is a MEDIUM run tagged with the id (in g_heap's chunks, under
+** g_medium_lock), past it a mapping of its own. sea_heap_destroy gives
+** every slab back at once: up to SLAB_KEEP_EMPTY per class join g_heap's
+** retained empties (where new heap slabs are taken from first), the rest
+** go; its runs are found by a walk of the chunks.
+** Heap blocks are not profiled and never sit in a thread cache.
+*/
+# define SEA_HEAPS_MAX 65536
+
+/* ** Transparent huge pages (off until sea_malloc_thp(true), or from
+** startup with KRAKEN_MALLOC_THP=1 in the environment):
+** TINY/SMALL zones are carved front to back out of THP_SIZE aligned
+** regions advised MADV_HUGEPAGE, so a heap of slabs sits in 2 MB TLB
+** entries. LARGE mappings of at least THP_SIZE are aligned and advised
+** the same way. Zones still go back one by one (the kernel splits the
+** huge page). The last zone of a region takes its tail as extra colour
+** room, blocks stay as many as in any zone of the class.
+*/
+# define THP_SIZE (2 * 1024 * 1024)
+# define THP_ENV  "KRAKEN_MALLOC_THP"
+
+/* ** Trim and background purge:
+** sea_malloc_trim(pad) hands back everything kept for reuse: the calling
+** thread's cache, retained empty zones and fully free MEDIUM chunks, the
+** LARGE cache past pad bytes, and (MADV_DONTNEED) the pages of partly
+** used zones and chunks that hold no live block, found from the bitmaps
+** and free runs. Pages past a zone's / chunk's high-water mark were never
+** touched and are skipped. Up to PURGE_BATCH zones of a class are
+** gathered under its lock: their free pages' blocks are held (marked
+** used) while the lock is dropped for the madvise calls, then freed
+** again. A zone stays advised until its next free, and only pages still
+** resident count as released, so a trim with nothing new returns 0.
+** The purge thread (sea_malloc_purge_start(ms), or KRAKEN_MALLOC_PURGE_MS
+** in the environment) runs decay and that page pass every interval, so
+** RSS comes down after a spike even if the program stops calling us.
+*/
+# define PURGE_ENV   "KRAKEN_MALLOC_PURGE_MS"
+# define PURGE_BATCH 16
+
+/* ** Tuning (g_conf):
+** KRAKEN_MALLOC_CONF="name:value,name:value" (k / m / g suffixes) is
+** read by the first allocation; sea_mallctl(name, &old, &new) reads and
+** writes the same names later. Defaults are the constants above.
+**   tiny_zone, small_zone  smallest / largest TINY/SMALL zone (page
+**                          multiples, 64KB <= small_zone <= THP_SIZE)
+**   small_max              largest size served from slabs, above it
+**                          MEDIUM (TINY_BLOCK_MAX .. SMALL_BLOCK_MAX)
+**   medium_max             largest MEDIUM run, above it LARGE
+**   large_cache            LARGE cache budget in bytes
+**   slab_keep, medium_keep retained empty zones per class / free chunks
+**   decay_ms               idle time before retained memory is advised
+**   tcache_max             largest size a thread caches (<= small_max,
+**                          TCACHE_MAX_SIZE), 0 = no thread cache
+**   tcache_bin, tcache_batch  blocks per bin / per refill and drain
+**   thp, purge_ms          as sea_malloc_thp / sea_malloc_purge_start
+** tiny_zone, small_zone and small_max only take effect from the
+** environment: blocks already handed out were placed by them, so
+** sea_mallctl reports them read-only (EPERM). KRAKEN_MALLOC_THP and
+** KRAKEN_MALLOC_PURGE_MS are read first, as thp and purge_ms. Bad names
+** or values in the environment are reported on stderr and skipped.
+*/
+# define CONF_ENV "KRAKEN_MALLOC_CONF"
+
+/* ** Reservations (sea_malloc_reserve):
+** Zones of a class mapped and faulted in ahead of time (one written
+** byte per page) and pinned: a pinned zone whose blocks are all free
+** goes on g_heap.reserve[] instead of being retained or released, and
+** decay, trim and the purge thread leave its pages alone. Allocation
+** takes a partial zone, then a reserved one, then a retained empty one.
+** sea_malloc_reserve_stats walks the class (under its lock) to show what
+** is left of the reserve: pinned zones, free blocks, resident bytes.
+*/
+
+/* ** Heap walk (sea_malloc_iterate):
+** Live blocks class by class (set bits of each zone's bitmap, ctz over
+** the words), then MEDIUM runs, LARGE blocks and the explicit heaps'.
+** Remote frees are applied and the caller's thread cache flushed first;
+** blocks in other threads' caches still count as live.
+** By default each class / tier lock is held while its blocks are visited:
+** the callback must not allocate or free. SEA_MALLOC_SNAPSHOT copies the
+** zones' metadata (bitmaps, run and block bounds) with every lock held
+** once, then visits the copy with none: a consistent picture, and the
+** callback may use the allocator (blocks it frees may still be visited).
+*/
+# define SEA_MALLOC_SNAPSHOT 1
+
+/*
+** ---------- STRUCTS ----------
+*/
+
+/* ** The Bitmap:
+    ** 0 = Free, 1 = Used.
+    ** Tiny Zone (16KB) / Min Block (16B) = 1024 blocks max.
+    ** 1024 bits / 64 bits per int = 16 integers.
+    ** Bits past total_blocks are set at creation so they never look free.
+    **
+    ** summary: bit i set <=> bitmap[i] still has a free block.
+    ** Finding a free block is ctz(summary) then ctz(~bitmap[i]).
+    **
+    ** data_offset: blocks start where the class alignment allows
+    ** (see class_align), never before the end of the header, plus the
+    ** slab's colour. The header fills whole cache lines: block 0 never
+    ** shares one with the bitmap.
+    **
+    ** fresh: blocks go out lowest index first, so everything from the
+    ** high-water mark on is still the kernel's zero page (calloc).
+    **
+    ** sampled_at: where up to 4 live profiler samples of the zone sit
+    ** (offset from the header / 16, 0 = none), sampled_more: the count of
+    ** the others (all of them for MEDIUM runs and LARGE blocks, and those
+    ** past the first MB of a zone, whose offset needs 17 bits). A free
+    ** only goes to the sample table when its block may be one of them.
+    **
+    ** heap_id: explicit heap owning the slab / run / LARGE block, 0 =
+    ** g_heap.
+    ** pinned: part of a reservation (g_heap only), never given back.
+*/
+
+//This structure sits at the VERY BEGINNING of every mmap'd zone (N or M bytes).
+typedef struct	s_slab
+{
+    struct s_slab *next;
+    struct s_slab *prev;
+
+    size_t   block_size;
+    uint32_t total_blocks;
+    uint32_t free_count;
+
+    uint8_t  type;       // 0 = TINY, 1 = SMALL, 2 = LARGE, 3 = MEDIUM
+    uint8_t  advised;    // retained: madvise'd, in use: free pages purged
+    uint16_t class_idx;  // index in g_heap.tiny[] / g_heap.small[]
+    uint16_t zone_pages; // length of the zone mapping (TINY/SMALL)
+    uint16_t data_offset; // first block, from the header (TINY/SMALL),
+                          // first page, in the chunk (MEDIUM)
+    uint16_t summary;
+    uint16_t fresh;      // blocks from here on never handed out: still zero
+    uint32_t stamp;      // ms clock when it went empty (retained slabs)
+    uint32_t sampled_more; // atomic
+    uint16_t heap_id;
+    uint16_t pinned;
+    uint64_t sampled_at;   // atomic, 4 x 16 bits
+
+    union
+    {
+        uint64_t       bitmap[16]; // TINY/SMALL
+        struct s_chunk *chunk;     // MEDIUM: the chunk the run is in
+    };
+}	t_slab;
+
+// Blocks right after a bare header must still be MIN_ALIGNMENT aligned
+_Static_assert(sizeof(t_slab) % MIN_ALIGNMENT == 0, "t_slab breaks alignment");
+_Static_assert(sizeof(t_slab) % SLAB_COLOUR_STEP == 0, "t_slab shares a line");
+
+/* ** t_tcache: one per thread.
+** A bin is a singly linked list threaded through the first word
+** of each cached block.
+*/
+typedef struct s_tcache_bin
+{
+    void     *head;
+    uint32_t count;
+}	t_tcache_bin;
+
+typedef struct s_tcache
+{
+    t_tcache_bin bins[TCACHE_CLASSES];
+    size_t       classes; // tcache_classes last seen, bins past it empty
+    int          state;  // 0 = not yet used, 1 = live, 2 = thread exiting
+}	t_tcache;
+
+
+/* ** t_chunk: a MEDIUM chunk.
+** Run descriptors live out of band, so user pointers stay page aligned:
+** one t_slab per run, from a pool, and one pointer per page in the chunk
+** header. The first and last page of every run, free or in use, point
+** at its descriptor, so either neighbour is one load away when
+** coalescing (inner pages are stale). For a run:
+**   total_blocks = length in pages, data_offset = first page
+**   free_count   = 1 if the run is free, 0 if in use
+**   block_size   = requested size (in use) / run bytes (free)
+*/
+typedef struct s_chunk
+{
+    struct s_chunk *next;
+    struct s_chunk *prev;
+    size_t   free_pages;
+    size_t   fresh;      // pages from here on never handed out: still zero
+    uint32_t stamp;      // ms clock when it went fully free
+
+    t_slab   *runs[MEDIUM_CHUNK_PAGES];
+}	t_chunk;
+
+# define MEDIUM_FIRST_PAGE ((sizeof(t_chunk) + PAGE_SIZE - 1) / PAGE_SIZE)
+
+/* ** Remote-free list of one class, alone on its cache line so pushes to
+** one class never bounce another's head. count is what the list holds,
+** near enough (pushers add after their CAS, the taker subtracts what it
+** took); once a push sees REMOTE_APPLY the pusher applies the list
+** itself if the class lock is free, so a zone emptied by remote frees
+** is seen as empty without waiting for an allocation or a decay pass.
+*/
+# define REMOTE_APPLY 64
+
+typedef struct s_remote
+{
+    void     *head;
+    uint32_t count;
+} __attribute__((aligned(64)))	t_remote;
+
+/* ** t_heap: The Global Manager
+** Instead of one list, we have an array of lists.
+** request 30 bytes -> round to 32 -> go to index 1 -> O(1) lookup.
+** tiny[] / small[] only hold slabs with free blocks (partial), so the
+** head always has room; slabs move to *_full[] when their last block
+** goes and back when one is freed.
+** large is still a linked liste
+*/
+typedef struct s_heap
+{
+    t_slab *tiny[MAX_TINY_CLASSES];
+    t_slab *small[MAX_SMALL_CLASSES];
+    t_slab *tiny_full[MAX_TINY_CLASSES];
+    t_slab *small_full[MAX_SMALL_CLASSES];
+    t_slab   *empty[NUM_SIZE_CLASSES];       // retained, all blocks free
+    uint32_t empty_count[NUM_SIZE_CLASSES];
+    t_slab   *reserve[NUM_SIZE_CLASSES];     // pinned, all blocks free
+    size_t   reserve_blocks[NUM_SIZE_CLASSES]; // in pinned zones, in use or not
+    uint32_t decay_stamp;                    // last slab_decay pass (atomic)
+    uint32_t colour_next;                    // next new slab's colour (atomic)
+    t_slab *large;
+    t_slab   *cache_large[LARGE_CACHE_BUCKETS];
+    uint32_t cache_bins;  // 1 = bucket not empty
+    size_t   cache_count;
+    size_t   cache_bytes;
+
+    t_chunk  *medium;
+    t_slab   *medium_free[MEDIUM_BINS];
+    uint64_t medium_bins[(MEDIUM_BINS + 63) / 64]; // 1 = bin not empty
+    size_t   medium_empty;                         // fully free chunks kept
+    t_slab   *medium_desc;                         // unused run descriptors
+
+    // MPSC remote-free lists, pushed lock-free
+    t_remote remote[NUM_SIZE_CLASSES];
+}	t_heap;
+
+/* ** An explicit heap: its own slab lists (tiny/small, *_full, empty and
+** large of the embedded t_heap; the rest unused) under one lock.
+** Heap locks are taken last: nothing else is locked while one is held.
+*/
+typedef struct s_sea_heap
+{
+    t_heap          heap;
+    pthread_mutex_t lock;
+    uint32_t        id;
+}	t_sea_heap;
+
+// Live explicit heaps by id, under lock (slab_heap reads it lock-free)
+typedef struct s_heaps
+{
+    t_sea_heap      *table[SEA_HEAPS_MAX];
+    uint16_t        free_ids[SEA_HEAPS_MAX];
+    uint32_t        nfree;
+    uint32_t        next_id;
+    uint32_t        live;      // atomic: sized frees look blocks up while > 0
+    pthread_mutex_t lock;
+}	t_heaps;
+
+/* ** Locks: one per slab class, one for MEDIUM, one for LARGE (active list
+** and cache). Each on its own cache line so unrelated classes never
+** bounce a line between them. Lookups (page map) take none.
+** Order when several are needed: classes ascending, MEDIUM, LARGE.
+*/
+typedef struct s_lock
+{
+    pthread_mutex_t mutex;
+} __attribute__((aligned(64)))	t_lock;
+
+/* ** Statistics:
+** Slab class traffic is counted per thread: plain stores to counters
+** only their thread writes, no lock and no shared cache line. Live
+** threads are linked so a snapshot can sum them; an exiting thread folds
+** its counts into g_stats. Everything else (MEDIUM, LARGE, slabs,
+** mappings) only moves on slow paths and lives in g_stats as relaxed
+** atomics. Nothing is ever derived from walking the heap.
+*/
+typedef struct s_thread_stats
+{
+    struct s_thread_stats *next;
+    struct s_thread_stats *prev;
+    uint64_t nmalloc[NUM_SIZE_CLASSES];
+    uint64_t nfree[NUM_SIZE_CLASSES];
+    int      state;  // 0 = not linked yet, 1 = live, 2 = thread exiting
+}	t_thread_stats;
+
+typedef struct s_stats
+{
+    uint64_t nmalloc[NUM_SIZE_CLASSES]; // exited threads (and late frees)
+    uint64_t nfree[NUM_SIZE_CLASSES];
+    uint64_t slabs[NUM_SIZE_CLASSES];
+    uint64_t zone_bytes[NUM_SIZE_CLASSES]; // each zone at its own size
+    uint64_t medium_nmalloc;
+    uint64_t medium_nfree;
+    uint64_t medium_bytes;   // pages of live runs
+    uint64_t medium_chunks;
+    uint64_t large_nmalloc;
+    uint64_t large_nfree;
+    uint64_t large_bytes;    // mappings of live blocks
+    uint64_t mmap_calls;
+    uint64_t munmap_calls;
+    uint64_t mapped;
+}	t_stats;
+
+/* ** sea_malloc_stats() snapshot. One t_alloc_stats per slab class, one
+** for MEDIUM and one for LARGE. spans: slabs, chunks or live mappings.
+** fragmentation = 1 - allocated / mapped (0 when nothing is mapped).
+*/
+typedef struct s_alloc_stats
+{
+    size_t   block_size;    // class size, 0 for MEDIUM / LARGE
+    uint64_t nmalloc;
+    uint64_t nfree;
+    uint64_t live;
+    size_t   allocated;
+    uint64_t spans;
+    size_t   mapped;
+    double   fragmentation;
+}	t_alloc_stats;
+
+typedef struct s_malloc_stats
+{
+    t_alloc_stats classes[NUM_SIZE_CLASSES];
+    t_alloc_stats medium;
+    t_alloc_stats large;
+    size_t   large_cached;       // bytes held by the LARGE cache
+    uint64_t large_cached_count;
+    uint64_t mmap_calls;
+    uint64_t munmap_calls;
+    size_t   mapped;             // everything, page map leaves included
+    size_t   allocated;
+    double   fragmentation;
+}	t_malloc_stats;
+
+// What is left of a class's reservation (sea_malloc_reserve_stats)
+typedef struct s_reserve_stats
+{
+    uint64_t slabs;     // pinned zones
+    uint64_t blocks;    // their blocks
+    uint64_t free;      // of which free (not counting thread caches)
+    size_t   mapped;    // bytes of those zones
+    size_t   resident;  // of which resident right now (mincore)
+}	t_reserve_stats;
+
+// One live block, as sea_malloc_iterate shows it
+typedef struct s_malloc_block
+{
+    void     *ptr;
+    size_t   size;      // class size for TINY/SMALL, requested size else
+    void     *zone;     // slab header, MEDIUM chunk or LARGE header
+    int      type;      // as t_slab: 0 TINY, 1 SMALL, 3 MEDIUM, 2 LARGE
+    int      class_idx; // -1 for MEDIUM / LARGE
+    uint32_t heap_id;   // explicit heap, 0 = g_heap
+}	t_malloc_block;
+
+// false stops the walk
+typedef bool	(*t_malloc_visit)(const t_malloc_block *block, void *ctx);
+
+/* ** Profiler tables, under g_prof.lock (only sampling and frees of
+** sampled blocks take it). Samples are open addressed by pointer.
+*/
+typedef struct s_prof_stack
+{
+    uint64_t hash;       // 0 = empty slot
+    uint32_t depth;
+    uint32_t live_count;
+    uint64_t live_bytes;
+    uint64_t total_count;
+    uint64_t total_bytes;
+    void     *frames[PROF_DEPTH];
+}	t_prof_stack;
+
+typedef struct s_prof_sample
+{
+    void     *ptr;       // NULL = empty slot
+    size_t   size;
+    uint32_t stack;
+}	t_prof_sample;
+
+typedef struct s_prof
+{
+    size_t          rate;      // mean bytes between samples, 0 = off (atomic)
+    size_t          period;    // last rate started with, for the dump
+    t_prof_stack    *stacks;
+    t_prof_sample   *samples;
+    uint32_t        nstacks;
+    uint32_t        nsamples;  // atomic: sized frees skip the lookup at 0
+    pthread_mutex_t lock;
+}	t_prof;
+
+// Per thread: bytes left before the next sample
+typedef struct s_prof_thread
+{
+    int64_t  left;
+    uint64_t rng;        // 0 = countdown not armed yet
+    int      busy;       // inside the profiler (backtrace may allocate)
+}	t_prof_thread;
+
+/* ** Trace file layout (native endian). ptr is the block handed out, or
+** given back for TRACE_FREE. ns is CLOCK_MONOTONIC taken after an
+** allocation and before a free (a moving realloc: in between), so a
+** trace sorted by ns never reuses an address before it was freed.
+*/
+typedef struct s_trace_header
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t event_size;
+}	t_trace_header;
+
+typedef struct s_trace_event
+{
+    uint64_t ns;
+    uint64_t ptr;
+    uint64_t old;
+    uint64_t size;
+    uint32_t thread;     // ring number: threads that never overlap may share
+    uint32_t op;
+}	t_trace_event;
+
+// One per thread that traced, reused once it exits. Owner writes head.
+typedef struct s_trace_ring
+{
+    struct s_trace_ring *next;
+    uint64_t            head;   // atomic
+    uint64_t            tail;   // atomic, moved under g_trace.lock
+    uint32_t            id;
+    uint32_t            owned;  // under g_trace.lock
+    t_trace_event       events[TRACE_RING_EVENTS];
+}	t_trace_ring;
+
+typedef struct s_trace
+{
+    int             on;       // atomic
+    int             fd;       // -1 = no trace file
+    t_trace_ring    *rings;   // never unlinked
+    uint32_t        nrings;
+    pthread_mutex_t lock;     // the file, the ring list and the tails
+}	t_trace;
+
+// Huge page mode: the region TINY/SMALL zones are being carved from
+typedef struct s_thp
+{
+    int             on;       // atomic
+    char            *next;    // next zone of the current region
+    char            *end;
+    pthread_mutex_t lock;     // the region (taken last, under class locks)
+}	t_thp;
+
+// Background purge thread
+typedef struct s_purge
+{
+    pthread_t       thread;
+    uint32_t        interval_ms;
+    int             running;
+    int             stop;
+    int             cond_ready;
+    pthread_mutex_t lock;      // the fields above
+    pthread_cond_t  cond;      // CLOCK_MONOTONIC, signalled by stop
+    pthread_mutex_t ctl;       // start / stop, held across the join
+}	t_purge;
+
+// Allocator tunables, word sized: read without a lock (see Tuning)
+typedef struct s_conf
+{
+    size_t  tiny_zone;
+    size_t  small_zone;
+    size_t  small_max;
+    size_t  medium_max;
+    size_t  large_cache;
+    size_t  slab_keep;
+    size_t  medium_keep;
+    size_t  decay_ms;
+    size_t  tcache_max;
+    size_t  tcache_classes; // size_to_class(tcache_max) + 1, 0 = off
+    size_t  tcache_bin;
+    size_t  tcache_batch;
+    int     ready;          // atomic, KRAKEN_MALLOC_CONF has been read
+    int     booting;        // atomic, someone is reading it
+}	t_conf;
+
+/*
+** ---------- GLOBALS -------------
+*/
+extern t_heap g_heap;
+extern t_lock g_class_lock[NUM_SIZE_CLASSES];
+extern t_lock g_medium_lock;
+extern t_lock g_large_lock;
+extern t_stats g_stats;
+extern __thread t_thread_stats g_thread_stats
+    __attribute__((tls_model("initial-exec")));
+extern t_prof g_prof;
+extern t_trace g_trace;
+extern t_heaps g_heaps;
+extern t_thp g_thp;
+extern t_purge g_purge;
+extern t_conf g_conf;
+extern __thread t_prof_thread g_prof_thread
+    __attribute__((tls_model("initial-exec")));
+
+/*
+** ---------- SIZE CLASSES ----------
+*/
+
+// 1..128 -> 0..7, then 4 classes per power of two
+static inline int size_to_class(size_t size)
+{
+    size_t  n;
+    int     lg;
+
+    if (size <= TINY_BLOCK_MAX)
+        return (size ? (size - 1) / MIN_ALIGNMENT : 0);
+    n = size - 1;
+    lg = 63 - __builtin_clzll(n);
+    return (MAX_TINY_CLASSES + (lg - 7) * 4 + ((n >> (lg - 2)) & 3));
+}
+
+static inline size_t class_to_size(int class_idx)
+{
+    int group;
+    int step;
+
+    if (class_idx < MAX_TINY_CLASSES)
+        return ((size_t)(class_idx + 1) * MIN_ALIGNMENT);
+    group = (class_idx - MAX_TINY_CLASSES) / 4;
+    step = (class_idx - MAX_TINY_CLASSES) % 4;
+    return (((size_t)TINY_BLOCK_MAX << group) + (size_t)(step + 1) * (32 << group));
+}
+
+/*
+** Every block of a class is aligned to the lowest set bit of its size,
+** capped at a page: 64, 192 or 320 are cache-line aligned, 4096 and 8192
+** page aligned. Only the first block has to be placed, the stride keeps it.
+*/
+static inline size_t class_align(size_t block_size)
+{
+    size_t align;
+
+    align = block_size & -block_size;
+    return (align > PAGE_SIZE ? PAGE_SIZE : align);
+}
+
+static inline size_t class_data_offset(size_t block_size)
+{
+    size_t align;
+
+    align = class_align(block_size);
+    return ((sizeof(t_slab) + align - 1) & ~(align - 1));
+}
+
+static inline char *slab_data(t_slab *slab)
+{
+    return ((char *)slab + slab->data_offset);
+}
+
+/*
+** Zone that holds (at most) SLAB_MAX_BLOCKS blocks, rounded down to a page
+** so the tail left over is always smaller than one block, within the
+** configured zone sizes.
+*/
+static inline size_t class_zone_size(int class_idx)
+{
+    size_t zone;
+    size_t block_size;
+
+    block_size = class_to_size(class_idx);
+    zone = class_data_offset(block_size) + SLAB_MAX_BLOCKS * block_size;
+    zone &= ~((size_t)PAGE_SIZE - 1);
+    if (zone < g_conf.tiny_zone)
+        zone = g_conf.tiny_zone;
+    if (zone > g_conf.small_zone)
+        zone = g_conf.small_zone;
+    return (zone);
+}
+
+void	conf_init(void);
+
+// One load per allocation once KRAKEN_MALLOC_CONF has been read
+static inline void conf_boot(void)
+{
+    if (__builtin_expect(!__atomic_load_n(&g_conf.ready, __ATOMIC_ACQUIRE), 0))
+        conf_init();
+}
+
+/*
+** Slab type sea_malloc(size) hands out: 0 TINY, 1 SMALL, 3 MEDIUM,
+** 2 LARGE. Read once per call: medium_max may change under us.
+*/
+static inline int size_type(size_t size)
+{
+    if (size <= TINY_BLOCK_MAX)
+        return (0);
+    if (size <= g_conf.small_max)
+        return (1);
+    if (size <= __atomic_load_n(&g_conf.medium_max, __ATOMIC_RELAXED))
+        return (3);
+    return (2);
+}
+
+// Lists a slab belongs to: its explicit heap's or g_heap's
+static inline t_heap *slab_heap(t_slab *slab)
+{
+    if (__builtin_expect(slab->heap_id != 0, 0))
+        return (&g_heaps.table[slab->heap_id]->heap);
+    return (&g_heap);
+}
+
+/*
+** Lock guarding a slab's bookkeeping, by tier (or its explicit heap's,
+** except for MEDIUM runs: every chunk is g_heap's)
+*/
+static inline pthread_mutex_t *slab_lock(t_slab *slab)
+{
+    if (__builtin_expect(slab->heap_id != 0, 0) && slab->type != 3)
+        return (&g_heaps.table[slab->heap_id]->lock);
+    if (slab->type < 2)
+        return (&g_class_lock[slab->class_idx].mutex);
+    if (slab->type == 3)
+        return (&g_medium_lock.mutex);
+    return (&g_large_lock.mutex);
+}
+
+static inline void stat_add(uint64_t *counter, int64_t delta)
+{
+    __atomic_fetch_add(counter, (uint64_t)delta, __ATOMIC_RELAXED);
+}
+
+void	stats_count_slow(int class_idx, uint64_t n, bool is_free);
+
+// n blocks of a class handed out (or given back), on this thread's counters
+static inline void stats_count(int class_idx, uint64_t n, bool is_free)
+{
+    uint64_t *counter;
+
+    if (__builtin_expect(g_thread_stats.state != 1, 0))
+    {
+        stats_count_slow(class_idx, n, is_free);
+        return;
+    }
+    counter = is_free ? &g_thread_stats.nfree[class_idx]
+                      : &g_thread_stats.nmalloc[class_idx];
+    // only this thread writes it: no RMW, just a store the snapshot can read
+    __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+void	prof_sample(void *ptr, size_t size);
+void	prof_check(t_slab *slab, void *ptr);
+
+// One subtraction per allocation until a sample is due
+static inline void prof_account(void *ptr, size_t size)
+{
+    g_prof_thread.left -= (int64_t)size;
+    if (__builtin_expect(g_prof_thread.left < 0, 0))
+        prof_sample(ptr, size);
+}
+
+// Two loads off the header's first line while its zone holds no sample
+static inline void prof_free(t_slab *slab, void *ptr)
+{
+    if (__builtin_expect(__atomic_load_n(&slab->sampled_at, __ATOMIC_RELAXED)
+                         | __atomic_load_n(&slab->sampled_more,
+                                           __ATOMIC_RELAXED), 0))
+        prof_check(slab, ptr);
+}
+
+void	trace_record(uint32_t op, void *ptr, uintptr_t old, size_t size,
+			uint64_t ns);
+uint64_t	trace_clock(void);
+
+// One load per call while tracing is off
+static inline void trace_op(uint32_t op, void *ptr, uintptr_t old, size_t size)
+{
+    if (__builtin_expect(__atomic_load_n(&g_trace.on, __ATOMIC_RELAXED), 0))
+        trace_record(op, ptr, old, size, 0);
+}
+
+// Timestamp for an event recorded later (0 while off)
+static inline uint64_t trace_stamp(void)
+{
+    if (__builtin_expect(__atomic_load_n(&g_trace.on, __ATOMIC_RELAXED), 0))
+        return (trace_clock());
+    return (0);
+}
+
+/*
+** ---------- PROTOTYPES ----------
+*/
+void	*sea_malloc(size_t size);
+void	sea_free(void *ptr);
+void	sea_free_sized(void *ptr, size_t size);
+size_t	sea_malloc_batch(size_t size, size_t count, void **out);
+void	sea_free_batch(void **ptrs, size_t count);
+void	*sea_realloc(void *ptr, size_t size);
+void	*sea_calloc(size_t count, size_t size);
+void	*sea_memalign(size_t alignment, size_t size);
+void	*sea_aligned_alloc(size_t alignment, size_t size);
+size_t	sea_malloc_usable_size(void *ptr);
+void	sea_malloc_stats(t_malloc_stats *out);
+void	sea_malloc_prof_start(size_t sample_bytes);
+void	sea_malloc_prof_stop(void);
+bool	sea_malloc_prof_dump(int fd);
+bool	sea_malloc_trace_start(const char *path);
+void	sea_malloc_trace_stop(void);
+t_sea_heap	*sea_heap_create(void);
+void	*sea_heap_alloc(t_sea_heap *heap, size_t size);
+void	sea_heap_destroy(t_sea_heap *heap);
+void	sea_malloc_thp(bool on);
+int	sea_malloc_trim(size_t pad);
+bool	sea_malloc_purge_start(uint32_t interval_ms);
+void	sea_malloc_purge_stop(void);
+int	sea_mallctl(const char *name, size_t *oldval, const size_t *newval);
+size_t	sea_malloc_reserve(size_t size, size_t count);
+bool	sea_malloc_reserve_stats(size_t size, t_reserve_stats *out);
+size_t	sea_malloc_iterate(t_malloc_visit visit, void *ctx, int flags);
+
+/* Helper functions */
+void	show_alloc_mem(void);
+void	show_alloc_mem_ex(void *ptr);
+t_slab	*find_slab_by_ptr(void *ptr, int *type_out);
+bool	is_slab_block(t_slab *slab, void *ptr);
+t_slab	**class_list(int class_idx, int list);
+t_slab	**heap_class_list(t_heap *heap, int class_idx, int list);
+void	slab_unlink(t_slab **head, t_slab *slab);
+void	slab_push(t_slab **head, t_slab *slab);
+void	*malloc_zeroed(size_t size);
+void	*malloc_block(size_t size);
+void	free_block(void *ptr);
+void	*heap_block(t_sea_heap *heap, size_t size);
+void	*large_map_base(t_slab *slab);
+size_t	large_map_size(t_slab *slab);
+
+/* Every lock, in order (display, fork) */
+void	heap_lock_all(void);
+void	heap_unlock_all(void);
+
+/* Zone and LARGE mappings, huge page aligned in THP mode */
+void	*zone_mmap(size_t *len);
+void	*large_mmap(size_t len);
+
+/* Counted mappings (statistics) */
+void	*heap_mmap(size_t len);
+void	heap_munmap(void *addr, size_t len);
+void	stats_fork_prepare(void);
+void	stats_fork_parent(void);
+void	stats_fork_child(void);
+void	prof_fork_prepare(void);
+void	prof_fork_parent(void);
+void	prof_fork_child(void);
+void	trace_fork_prepare(void);
+void	trace_fork_parent(void);
+void	trace_fork_child(void);
+void	heaps_lock_all(void);
+void	heaps_unlock_all(void);
+void	heaps_fork_child(void);
+void	thp_fork_prepare(void);
+void	thp_fork_parent(void);
+void	thp_fork_child(void);
+void	purge_fork_prepare(void);
+void	purge_fork_parent(void);
+void	purge_fork_child(void);
+
+/* Slab internals (caller holds the slab's lock, see slab_lock) */
+t_slab	*init_new_slab(int type, int class_index, size_t block_size);
+size_t	alloc_from_slab(t_slab *slab, void **out, size_t count,
+			bool *zeroed);
+void	*large_register(t_slab *slab);
+size_t	allocate_tiny_small_batch(size_t size, void **out, size_t count,
+			bool *zeroed);
+void	free_slab_block(t_slab *slab, void *ptr);
+void	free_slab_blocks(t_slab *slab, const uint64_t *mask, uint32_t words);
+void	slab_release(t_slab *slab);
+
+/* Remote frees (push is lock-free, take needs the class lock) */
+void	remote_free_push(int class_idx, void *first, void *last,
+			uint32_t count);
+size_t	remote_free_take(int class_idx, void **out, size_t count);
+void	remote_free_reclaim_all(void);
+
+/* Decay of retained memory (caller holds no lock) */
+uint32_t	now_ms(void);
+void	slab_decay(bool force);
+void	madvise_free(void *start, size_t len);
+
+/* LARGE cache (caller holds g_large_lock) */
+t_slab	*large_cache_take(size_t map_size);
+bool	large_cache_put(t_slab *slab);
+void	large_cache_decay(uint32_t now, bool force);
+size_t	large_cache_trim(size_t keep);
+
+/* Medium page runs (caller holds g_medium_lock) */
+void	*allocate_medium(size_t size, size_t *dirty);
+void	free_medium(t_slab *run);
+void	*medium_run_addr(t_slab *run);
+size_t	medium_purge(bool release);
+void	medium_release_heap(uint32_t heap_id);
+void	medium_decay(uint32_t now, bool force);
+
+/* Thread cache */
+void	*tcache_alloc(size_t size);
+bool	tcache_free(int class_idx, void *ptr);
+void	tcache_flush(void);
+
+/* Page map */
+bool	pagemap_set(void *start, size_t len, t_slab *slab);
+t_slab	*pagemap_get(const void *ptr);
+
+#endif
@@ -0,0 +1,69 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: sea_bzero_fast.c                                            */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 18:32:44 by espadara                              */
+/*      Updated: 2026/10/17 18:32:44 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "sea_core.h"
+
+void	*sea_bzero_fast(void *s, size_t n)
+{
+    unsigned char   *d = (unsigned char *)s;
+    __m128i         zero = _mm_setzero_si128();
+    __m128i         *d_vec;
+
+    // Handle small sizes (< 16 bytes) immediately
+    if (n < 16)
+        {
+            while (n--)
+                *d++ = 0;
+            return (s);
+        }
+
+    // One unaligned head store, then aligned stores from the next boundary
+    _mm_storeu_si128((__m128i *)d, zero);
+    d_vec = (__m128i *)(((uintptr_t)d + 16) & ~(uintptr_t)15);
+    n -= (unsigned char *)d_vec - d;
+
+    // SIMD Loop (Unrolled 4x = 64 bytes per iteration)
+    while (n >= 64)
+    {
+        _mm_store_si128(d_vec + 0, zero);
+        _mm_store_si128(d_vec + 1, zero);
+        _mm_store_si128(d_vec + 2, zero);
+        _mm_store_si128(d_vec + 3, zero);
+        d_vec += 4;
+        n -= 64;
+    }
+
+    //Handle remaining 16-byte chunks
+    while (n >= 16)
+    {
+        _mm_store_si128(d_vec++, zero);
+        n -= 16;
+    }
+// TAIL: one unaligned store ending on the last byte
+    if (n)
+        _mm_storeu_si128((__m128i *)((unsigned char *)d_vec + n - 16), zero);
+
+    return (s);
+}
@@ -0,0 +1,311 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: conf.c                                                      */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 20:06:12 by espadara                              */
+/*      Updated: 2026/10/17 21:10:17 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+#include <errno.h>
+#include <stdlib.h>
+
+t_conf g_conf = {
+  .tiny_zone = TINY_ZONE_SIZE,
+  .small_zone = SMALL_ZONE_SIZE,
+  .small_max = SMALL_BLOCK_MAX,
+  .medium_max = MEDIUM_BLOCK_MAX,
+  .large_cache = LARGE_CACHE_BYTES,
+  .slab_keep = SLAB_KEEP_EMPTY,
+  .medium_keep = MEDIUM_KEEP_CHUNKS,
+  .decay_ms = SLAB_DECAY_MS,
+  .tcache_max = TCACHE_MAX_SIZE,
+  .tcache_classes = TCACHE_CLASSES,
+  .tcache_bin = TCACHE_BIN_MAX,
+  .tcache_batch = TCACHE_BATCH};
+
+/*
+** One tunable: a g_conf field, stored as is unless set does it (rounded,
+** or with a side effect), or (value NULL) state kept elsewhere, reached
+** through get / set.
+*/
+typedef struct s_conf_opt
+{
+  const char  *name;
+  size_t      *value;
+  size_t      min;
+  size_t      max;
+  bool        boot;   // environment only
+  int         (*set)(size_t value);
+  size_t      (*get)(void);
+}	t_conf_opt;
+
+static int conf_set_tiny_zone(size_t value)
+{
+  g_conf.tiny_zone = (value + PAGE_SIZE - 1) & ~((size_t)PAGE_SIZE - 1);
+  return (0);
+}
+
+static int conf_set_small_zone(size_t value)
+{
+  g_conf.small_zone = (value + PAGE_SIZE - 1) & ~((size_t)PAGE_SIZE - 1);
+  return (0);
+}
+
+// Largest class size up to limit: the tcache never hands out more
+static void conf_tcache_limit(size_t limit)
+{
+  int class_idx;
+
+  class_idx = limit ? size_to_class(limit) : -1;
+  if (class_idx >= 0 && class_to_size(class_idx) > limit)
+    class_idx--;
+  __atomic_store_n(&g_conf.tcache_max,
+                   class_idx < 0 ? 0 : class_to_size(class_idx),
+                   __ATOMIC_RELAXED);
+  __atomic_store_n(&g_conf.tcache_classes, (size_t)(class_idx + 1),
+                   __ATOMIC_RELAXED);
+}
+
+static int conf_set_tcache_max(size_t value)
+{
+  if (value > g_conf.small_max)
+    return (EINVAL);
+  conf_tcache_limit(value);
+  return (0);
+}
+
+// Past small_max is MEDIUM: the thread cache stops there too
+static int conf_set_small_max(size_t value)
+{
+  g_conf.small_max = value;
+  if (g_conf.tcache_max > g_conf.small_max)
+    conf_tcache_limit(g_conf.small_max);
+  return (0);
+}
+
+// A smaller budget applies at once
+static int conf_set_large_cache(size_t value)
+{
+  __atomic_store_n(&g_conf.large_cache, value, __ATOMIC_RELAXED);
+  pthread_mutex_lock(&g_large_lock.mutex);
+  large_cache_trim(value);
+  pthread_mutex_unlock(&g_large_lock.mutex);
+  return (0);
+}
+
+static int conf_set_thp(size_t value)
+{
+  sea_malloc_thp(value != 0);
+  return (0);
+}
+
+static size_t conf_get_thp(void)
+{
+  return (__atomic_load_n(&g_thp.on, __ATOMIC_RELAXED) != 0);
+}
+
+static int conf_set_purge_ms(size_t value)
+{
+  if (!value)
+    sea_malloc_purge_stop();
+  else if (!sea_malloc_purge_start((uint32_t)value))
+    return (EAGAIN);
+  return (0);
+}
+
+static size_t conf_get_purge_ms(void)
+{
+  size_t interval;
+
+  pthread_mutex_lock(&g_purge.lock);
+  interval = g_purge.running ? g_purge.interval_ms : 0;
+  pthread_mutex_unlock(&g_purge.lock);
+  return (interval);
+}
+
+static const t_conf_opt g_conf_opts[] = {
+  {"tiny_zone", &g_conf.tiny_zone, PAGE_SIZE, THP_SIZE, true, conf_set_tiny_zone, NULL},
+  {"small_zone", &g_conf.small_zone, 64 * 1024, THP_SIZE, true, conf_set_small_zone, NULL},
+  {"small_max", &g_conf.small_max, TINY_BLOCK_MAX, SMALL_BLOCK_MAX, true,
+   conf_set_small_max, NULL},
+  {"medium_max", &g_conf.medium_max, 0, MEDIUM_BLOCK_MAX, false, NULL, NULL},
+  {"large_cache", &g_conf.large_cache, 0, SIZE_MAX, false,
+   conf_set_large_cache, NULL},
+  {"slab_keep", &g_conf.slab_keep, 0, 1 << 20, false, NULL, NULL},
+  {"medium_keep", &g_conf.medium_keep, 0, 1 << 20, false, NULL, NULL},
+  {"decay_ms", &g_conf.decay_ms, 1, 1 << 30, false, NULL, NULL},
+  {"tcache_max", &g_conf.tcache_max, 0, TCACHE_MAX_SIZE, false,
+   conf_set_tcache_max, NULL},
+  {"tcache_bin", &g_conf.tcache_bin, 1, TCACHE_BIN_LIMIT, false, NULL, NULL},
+  {"tcache_batch", &g_conf.tcache_batch, 1, TCACHE_BATCH_LIMIT, false,
+   NULL, NULL},
+  {"thp", NULL, 0, 1, false, conf_set_thp, conf_get_thp},
+  {"purge_ms", NULL, 0, UINT32_MAX, false, conf_set_purge_ms,
+   conf_get_purge_ms},
+};
+
+static const t_conf_opt *conf_find(const char *name, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof(g_conf_opts) / sizeof(g_conf_opts[0]); i++)
+    if (!sea_strncmp(g_conf_opts[i].name, name, len)
+        && !g_conf_opts[i].name[len])
+      return (&g_conf_opts[i]);
+  return (NULL);
+}
+
+static size_t conf_read(const t_conf_opt *opt)
+{
+  if (opt->get)
+    return (opt->get());
+  return (__atomic_load_n(opt->value, __ATOMIC_RELAXED));
+}
+
+static int conf_write(const t_conf_opt *opt, size_t value)
+{
+  if (value < opt->min || value > opt->max)
+    return (EINVAL);
+  if (opt->set)
+    return (opt->set(value));
+  __atomic_store_n(opt->value, value, __ATOMIC_RELAXED);
+  return (0);
+}
+
+static void conf_warn(const char *env, const char *item, size_t len)
+{
+  sea_putstr_fd("krakenlib: ", 2);
+  sea_putstr_fd(env, 2);
+  sea_putstr_fd(": bad option '", 2);
+  if (write(2, item, len) < 0)
+    return;
+  sea_putstr_fd("'\n", 2);
+}
+
+// Decimal with an optional k / m / g suffix, the whole of [str, end)
+static bool conf_value(const char *str, const char *end, size_t *out)
+{
+  size_t  value;
+  size_t  shift;
+
+  if (str == end)
+    return (false);
+  value = 0;
+  while (str < end && *str >= '0' && *str <= '9')
+    {
+      if (value > (SIZE_MAX - 9) / 10)
+        return (false);
+      value = value * 10 + (size_t)(*str++ - '0');
+    }
+  shift = 0;
+  if (str < end && (*str == 'k' || *str == 'K'))
+    shift = 10;
+  else if (str < end && (*str == 'm' || *str == 'M'))
+    shift = 20;
+  else if (str < end && (*str == 'g' || *str == 'G'))
+    shift = 30;
+  if (shift)
+    str++;
+  if (str != end || (shift && value > (SIZE_MAX >> shift)))
+    return (false);
+  *out = value << shift;
+  return (true);
+}
+
+// "name:value,name:value": each bad item is reported and skipped
+static void conf_parse(const char *conf)
+{
+  const char          *item;
+  const char          *colon;
+  const t_conf_opt    *opt;
+  size_t              value;
+
+  while (*conf)
+    {
+      item = conf;
+      while (*conf && *conf != ',')
+        conf++;
+      colon = item;
+      while (colon < conf && *colon != ':')
+        colon++;
+      if (conf != item
+          && (colon == conf || !(opt = conf_find(item, colon - item))
+              || !conf_value(colon + 1, conf, &value)
+              || conf_write(opt, value)))
+        conf_warn(CONF_ENV, item, conf - item);
+      if (*conf)
+        conf++;
+    }
+}
+
+// A variable standing for one option, its whole value checked the same way
+static void conf_env(const char *env, const char *name)
+{
+  const char          *str;
+  const t_conf_opt    *opt;
+  size_t              value;
+
+  if (!(str = getenv(env)) || !*str)
+    return;
+  opt = conf_find(name, sea_strlen(name));
+  if (!conf_value(str, str + sea_strlen(str), &value) || conf_write(opt, value))
+    conf_warn(env, str, sea_strlen(str));
+}
+
+/*
+** First allocation: read KRAKEN_MALLOC_THP and KRAKEN_MALLOC_PURGE_MS,
+** then KRAKEN_MALLOC_CONF, which wins where they overlap. Allocations
+** racing with it, or made by it (starting the purge thread), go by the
+** defaults.
+*/
+void conf_init(void)
+{
+  const char *env;
+
+  if (__atomic_exchange_n(&g_conf.booting, 1, __ATOMIC_ACQ_REL))
+    return;
+  conf_env(THP_ENV, "thp");
+  conf_env(PURGE_ENV, "purge_ms");
+  if ((env = getenv(CONF_ENV)))
+    conf_parse(env);
+  __atomic_store_n(&g_conf.ready, 1, __ATOMIC_RELEASE);
+}
+
+/*
+** Read a tunable into *oldval and / or set it from *newval (either may be
+** NULL). 0, or ENOENT (no such name), EINVAL (out of range), EPERM
+** (environment only), EAGAIN (the purge thread didn't start).
+*/
+__attribute__((visibility("default")))
+int sea_mallctl(const char *name, size_t *oldval, const size_t *newval)
+{
+  const t_conf_opt *opt;
+
+  conf_boot();
+  if (!name || !(opt = conf_find(name, sea_strlen(name))))
+    return (ENOENT);
+  if (oldval)
+    *oldval = conf_read(opt);
+  if (!newval)
+    return (0);
+  if (opt->boot)
+    return (EPERM);
+  return (conf_write(opt, *newval));
+}
@@ -0,0 +1,141 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: decay.c                                                     */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 17:56:19 by espadara                              */
+/*      Updated: 2026/10/17 21:16:24 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+#include <time.h>
+
+// Coarse monotonic clock in ms: vDSO, no syscall, wraps every ~49 days
+uint32_t now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return ((uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000));
+}
+
+// Lazy release: MADV_FREE where the kernel has it, DONTNEED otherwise
+void madvise_free(void *start, size_t len)
+{
+#ifdef MADV_FREE
+  if (madvise(start, len, MADV_FREE) == 0)
+    return;
+#endif
+  madvise(start, len, MADV_DONTNEED);
+}
+
+// Give the block pages back but keep the mapping (and the header page)
+static void slab_advise(t_slab *slab)
+{
+  char  *start;
+  char  *end;
+
+  start = (char *)(((uintptr_t)(slab + 1) + PAGE_SIZE - 1)
+                   & ~((uintptr_t)PAGE_SIZE - 1));
+  end = (char *)slab + (size_t)slab->zone_pages * PAGE_SIZE;
+  if (start < end)
+    madvise_free(start, end - start);
+  slab->advised = 1;
+}
+
+void slab_release(t_slab *slab)
+{
+  size_t zone_size = (size_t)slab->zone_pages * PAGE_SIZE;
+
+  pagemap_set(slab, zone_size, NULL);
+  stat_add(&g_stats.slabs[slab->class_idx], -1);
+  stat_add(&g_stats.zone_bytes[slab->class_idx], -(int64_t)zone_size);
+  heap_munmap(slab, zone_size);
+}
+
+// A forced pass waits for every lock, an unforced one takes what's free
+static bool decay_lock(pthread_mutex_t *lock, bool force)
+{
+  if (force)
+    return (pthread_mutex_lock(lock) == 0);
+  return (pthread_mutex_trylock(lock) == 0);
+}
+
+/*
+** Walk the retained empty slabs and the LARGE cache:
+** idle for decay_ms -> madvise,
+** idle for twice that -> munmap. Fully free MEDIUM chunks past
+** medium_keep go once idle for decay_ms. Rate limited to a pass every half decay
+** period unless forced; the thread that wins the stamp runs it, one
+** class lock at a time. An unforced pass skips locks that are busy: it
+** may run from under another lock's holder, and the class keeps until
+** the next pass anyway.
+*/
+void slab_decay(bool force)
+{
+  uint32_t  now;
+  uint32_t  stamp;
+  uint32_t  idle;
+  uint32_t  decay;
+  int       i;
+  t_slab    *slab;
+  t_slab    *next;
+
+  now = now_ms();
+  decay = (uint32_t)__atomic_load_n(&g_conf.decay_ms, __ATOMIC_RELAXED);
+  stamp = __atomic_load_n(&g_heap.decay_stamp, __ATOMIC_RELAXED);
+  if (!force && (now - stamp < decay / 2
+                 || !__atomic_compare_exchange_n(&g_heap.decay_stamp, &stamp,
+                                                 now, false, __ATOMIC_RELAXED,
+                                                 __ATOMIC_RELAXED)))
+    return;
+  if (force)
+    __atomic_store_n(&g_heap.decay_stamp, now, __ATOMIC_RELAXED);
+  for (i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+      if (!decay_lock(&g_class_lock[i].mutex, force))
+        continue;
+      // remotely freed blocks may be all that keeps a slab from going empty
+      remote_free_take(i, NULL, 0);
+      slab = g_heap.empty[i];
+      while (slab)
+        {
+          next = slab->next;
+          idle = now - slab->stamp;
+          if (force || idle >= 2 * decay)
+            {
+              slab_unlink(&g_heap.empty[i], slab);
+              g_heap.empty_count[i]--;
+              slab_release(slab);
+            }
+          else if (idle >= decay && !slab->advised)
+            slab_advise(slab);
+          slab = next;
+        }
+      pthread_mutex_unlock(&g_class_lock[i].mutex);
+    }
+  if (decay_lock(&g_medium_lock.mutex, force))
+    {
+      medium_decay(now, force);
+      pthread_mutex_unlock(&g_medium_lock.mutex);
+    }
+  if (!decay_lock(&g_large_lock.mutex, force))
+    return;
+  large_cache_decay(now, force);
+  pthread_mutex_unlock(&g_large_lock.mutex);
+}
@@ -18,116 +18,259 @@
 /*      Filename: free.c                                                      */
 /*      By: espadara <espadara@pirate.capn.gg>                                */
 /*      Created: 2025/11/22 12:08:27 by espadara                              */
-/*      Updated: 2025/11/23 17:56:48 by espadara                              */
+/*      Updated: 2026/10/17 21:51:06 by espadara                              */
 /*                                                                            */
 /* ************************************************************************** */
 
 #include "sea_malloc.h"
 
-static void free_slab_block(t_slab *slab, void *ptr, int type, int class_idx)
+/*
+** Clear mask[i] in bitmap[i] for every word i set in words: one store per
+** word however many blocks it frees, and the list moves done once for
+** the whole lot. mask is only read for the words listed.
+*/
+void free_slab_blocks(t_slab *slab, const uint64_t *mask, uint32_t words)
 {
-  size_t      offset;
-  int         block_idx;
-  int         bitmap_idx;
-  int         bit_pos;
+  uint32_t  left;
+  uint32_t  freed;
+  int       i;
+  bool      was_full;
+  t_heap    *heap;
 
-  offset = (char *)ptr - ((char *)slab + sizeof(t_slab));
-  block_idx = offset / slab->block_size;
-
-  // which int and which bit in that int?
-  bitmap_idx = block_idx / 64;
-  bit_pos = block_idx % 64;
-
-  slab->bitmap[bitmap_idx] &= ~(1ULL << bit_pos);
-  slab->free_count++;
+  was_full = (slab->free_count == 0);
+  // maybe a new free page: the next purge pass looks at the zone again
+  slab->advised = 0;
+  freed = 0;
+  left = words;
+  while (left)
+    {
+      i = __builtin_ctz(left);
+      left &= left - 1;
+      slab->bitmap[i] &= ~mask[i];
+      freed += __builtin_popcountll(mask[i]);
+    }
+  slab->summary |= words;
+  slab->free_count += freed;
+  heap = slab_heap(slab);
+  // full -> partial: back to the front, it's the hottest slab we have
+  if (was_full)
+    {
+      slab_unlink(heap_class_list(heap, slab->class_idx, 1), slab);
+      slab_push(heap_class_list(heap, slab->class_idx, 0), slab);
+    }
 
   if (slab->free_count == slab->total_blocks)
     {
-      if (slab->prev)
-        slab->prev->next = slab->next;
-      else
+      slab_unlink(heap_class_list(heap, slab->class_idx, 0), slab);
+      if (slab->pinned)
+        slab_push(&heap->reserve[slab->class_idx], slab);
+      // Keep a few empty zones around so alloc/free ping-pong stays off mmap
+      else if (heap->empty_count[slab->class_idx]
+          < __atomic_load_n(&g_conf.slab_keep, __ATOMIC_RELAXED))
         {
-          if (type == 0) g_heap.tiny[class_idx] = slab->next;
-          else           g_heap.small[class_idx] = slab->next;
+          slab->stamp = now_ms();
+          slab->advised = 0;
+          slab_push(heap_class_list(heap, slab->class_idx, 2), slab);
+          heap->empty_count[slab->class_idx]++;
         }
-      if (slab->next)
-        slab->next->prev = slab->prev;
-
-      size_t zone_size = (type == 0) ? TINY_ZONE_SIZE : SMALL_ZONE_SIZE;
-      munmap(slab, zone_size);
+      else
+        slab_release(slab);
     }
 }
 
-static bool free_large(void *ptr)
+void free_slab_block(t_slab *slab, void *ptr)
+{
+  uint64_t  mask[SLAB_MAX_BLOCKS / 64];
+  size_t    block_idx;
+
+  block_idx = ((char *)ptr - slab_data(slab)) / slab->block_size;
+
+  // which int and which bit in that int?
+  mask[block_idx / 64] = 1ULL << (block_idx % 64);
+  free_slab_blocks(slab, mask, 1U << (block_idx / 64));
+}
+
+// O(1): the header sits right before the user pointer
+static void free_large(t_slab *slab)
+{
+  // Unlink from active list
+  if (slab->prev)
+    slab->prev->next = slab->next;
+  else
+    slab_heap(slab)->large = slab->next;
+  if (slab->next)
+    slab->next->prev = slab->prev;
+
+  // Cached or not, it's no longer a live pointer
+  pagemap_set(slab + 1, 1, NULL);
+  stat_add(&g_stats.large_nfree, 1);
+  stat_add(&g_stats.large_bytes, -(int64_t)large_map_size(slab));
+
+  // CACHING LOGIC: bucketed, bounded by bytes. Aligned blocks (header
+  // not at the mapping start) and explicit heaps' (the cache is under
+  // g_large_lock) go straight back to the kernel.
+  if (slab->heap_id || ((uintptr_t)slab & (PAGE_SIZE - 1))
+      || !large_cache_put(slab))
+    heap_munmap(large_map_base(slab), large_map_size(slab));
+}
+
+// sea_free, untraced
+void free_block(void *ptr)
 {
-  t_slab *slab = g_heap.large;
-  void *data_start;
+  t_slab          *slab;
+  int             type;
+  pthread_mutex_t *lock;
 
-  while (slab)
+  if (!ptr)
+    return;
+
+  // Lock-free classification through the page map
+  slab = find_slab_by_ptr(ptr, &type);
+  if (!slab)
+    return;
+  if (type < 2 && !is_slab_block(slab, ptr))
+    return;
+  prof_free(slab, ptr);
+  if (type < 2)
     {
-      data_start = (void *)(slab + 1);
-      if (ptr == data_start)
+      stats_count(slab->class_idx, 1, true);
+      // an explicit heap's block goes straight back to its slab
+      if (slab->heap_id)
         {
-          // Unlink from active list
-          if (slab->prev)
-            slab->prev->next = slab->next;
-          else
-            g_heap.large = slab->next;
-          if (slab->next)
-            slab->next->prev = slab->prev;
-
-          // CACHING LOGIC
-          if (g_heap.cache_count < CACHE_SIZE)
-          {
-            slab->prev = NULL;
-            // Add to cache list head
-            slab->next = g_heap.cache_large;
-            if (g_heap.cache_large)
-              g_heap.cache_large->prev = slab;
-            g_heap.cache_large = slab;
-            g_heap.cache_count++;
-          }
-          else
-            {
-              // Cache full, really unmap
-              size_t total_size = slab->block_size + sizeof(t_slab);
-              // Re-align to page size just to be safe for munmap length
-              total_size = (total_size + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1);
-              munmap(slab, total_size);
-          }
-          return (true);
+          lock = slab_lock(slab);
+          pthread_mutex_lock(lock);
+          free_slab_block(slab, ptr);
+          pthread_mutex_unlock(lock);
+          return;
         }
-      slab = slab->next;
+      // no room in the thread cache: the remote list, still no lock
+      if (!tcache_free(slab->class_idx, ptr))
+        remote_free_push(slab->class_idx, ptr, ptr, 1);
+      return;
     }
-  return (false);
+
+  // the header may be gone once freed: pick the lock first
+  lock = slab_lock(slab);
+  pthread_mutex_lock(lock);
+  if (type == 3)
+    free_medium(slab);
+  else
+    free_large(slab);
+  pthread_mutex_unlock(lock);
+  slab_decay(false);
 }
 
 __attribute__((visibility("default")))
 void sea_free(void *ptr)
 {
-  t_slab  *slab;
-  int     type = 0;
-  int     class_idx = 0;
-
   if (!ptr)
     return;
+  trace_op(TRACE_FREE, ptr, 0, 0);
+  free_block(ptr);
+}
 
-  pthread_mutex_lock(&g_malloc_mutex);
+/*
+** The caller knows the size it asked for (or anything up to
+** sea_malloc_usable_size): TINY/SMALL blocks go to the thread cache or
+** the remote list by class, without looking the pointer up at all.
+** Blocks from sea_aligned_alloc / sea_memalign go through sea_free, and
+** so do explicit heaps' while any is alive (they're looked up then).
+*/
+__attribute__((visibility("default")))
+void sea_free_sized(void *ptr, size_t size)
+{
+  int     class_idx;
+  t_slab  *slab;
 
-  slab = find_slab_by_ptr(ptr, &type);
-  if (slab)
+  if (!ptr)
+    return;
+  trace_op(TRACE_FREE, ptr, 0, size);
+  if (size == 0 || size > g_conf.small_max
+      || (__atomic_load_n(&g_heaps.live, __ATOMIC_RELAXED)
+          && (slab = pagemap_get(ptr)) && slab->heap_id))
     {
-      // Reverse engineer the class index from block_size
-      // Size 32 -> (32 / 16) - 1 = Index 1
-      class_idx = (slab->block_size / MIN_ALIGNMENT) - 1;
-      free_slab_block(slab, ptr, type, class_idx);
-      pthread_mutex_unlock(&g_malloc_mutex);
+      free_block(ptr);
       return;
     }
-  if (free_large(ptr))
+  class_idx = size_to_class(size);
+  stats_count(class_idx, 1, true);
+  if (__atomic_load_n(&g_prof.nsamples, __ATOMIC_RELAXED))
+    prof_free(pagemap_get(ptr), ptr);
+  if (!tcache_free(class_idx, ptr))
+    remote_free_push(class_idx, ptr, ptr, 1);
+}
+
+/*
+** Bulk free: one lock round-trip per run of pointers sharing a lock, and
+** bits of one slab are gathered into word masks and cleared together.
+** Runs are as long as the caller keeps same-class pointers together.
+*/
+__attribute__((visibility("default")))
+void sea_free_batch(void **ptrs, size_t count)
+{
+  uint64_t        mask[SLAB_MAX_BLOCKS / 64];
+  uint32_t        words;
+  t_slab          *pending;
+  t_slab          *slab;
+  pthread_mutex_t *held;
+  pthread_mutex_t *lock;
+  size_t          idx;
+  int             type;
+
+  // all of them before any is released (see t_trace_event)
+  if (__atomic_load_n(&g_trace.on, __ATOMIC_RELAXED))
+    for (idx = 0; idx < count; idx++)
+      if (ptrs[idx])
+        trace_record(TRACE_FREE, ptrs[idx], 0, 0, 0);
+  pending = NULL;
+  held = NULL;
+  words = 0;
+  while (count--)
     {
-      pthread_mutex_unlock(&g_malloc_mutex);
-      return;
+      // checked as free_block does, before the profiler hears of it
+      if (!*ptrs || !(slab = find_slab_by_ptr(*ptrs, &type))
+          || (type < 2 && !is_slab_block(slab, *ptrs)))
+        {
+          ptrs++;
+          continue;
+        }
+      lock = slab_lock(slab);
+      if (pending && (slab != pending || lock != held))
+        {
+          free_slab_blocks(pending, mask, words);
+          pending = NULL;
+        }
+      if (lock != held)
+        {
+          if (held)
+            pthread_mutex_unlock(held);
+          pthread_mutex_lock(lock);
+          held = lock;
+        }
+      prof_free(slab, *ptrs);
+      if (type == 3)
+        free_medium(slab);
+      else if (type == 2)
+        free_large(slab);
+      else
+        {
+          idx = ((char *)*ptrs - slab_data(slab)) / slab->block_size;
+          stats_count(slab->class_idx, 1, true);
+          if (!pending)
+            {
+              pending = slab;
+              words = 0;
+            }
+          if (!(words & (1U << (idx / 64))))
+            mask[idx / 64] = 0;
+          words |= 1U << (idx / 64);
+          mask[idx / 64] |= 1ULL << (idx % 64);
+        }
+      ptrs++;
     }
-  pthread_mutex_unlock(&g_malloc_mutex);
+  if (pending)
+    free_slab_blocks(pending, mask, words);
+  if (held)
+    pthread_mutex_unlock(held);
+  slab_decay(false);
 }
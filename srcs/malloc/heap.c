@@ -0,0 +1,331 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: heap.c                                                      */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 19:37:08 by espadara                              */
+/*      Updated: 2026/10/17 20:59:44 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "sea_malloc.h"
+
+t_heaps g_heaps = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+// Give heap an id (table slot); false once SEA_HEAPS_MAX - 1 are alive
+static bool heap_register(t_sea_heap *heap)
+{
+  pthread_mutex_lock(&g_heaps.lock);
+  if (g_heaps.nfree)
+    heap->id = g_heaps.free_ids[--g_heaps.nfree];
+  else if (g_heaps.next_id < SEA_HEAPS_MAX - 1)
+    heap->id = ++g_heaps.next_id;
+  else
+    {
+      pthread_mutex_unlock(&g_heaps.lock);
+      return (false);
+    }
+  g_heaps.table[heap->id] = heap;
+  __atomic_add_fetch(&g_heaps.live, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&g_heaps.lock);
+  return (true);
+}
+
+static void heap_unregister(t_sea_heap *heap)
+{
+  pthread_mutex_lock(&g_heaps.lock);
+  g_heaps.table[heap->id] = NULL;
+  g_heaps.free_ids[g_heaps.nfree++] = heap->id;
+  __atomic_sub_fetch(&g_heaps.live, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&g_heaps.lock);
+}
+
+__attribute__((visibility("default")))
+t_sea_heap *sea_heap_create(void)
+{
+  t_sea_heap *heap;
+
+  heap = malloc_zeroed(sizeof(t_sea_heap));
+  if (!heap)
+    return (NULL);
+  pthread_mutex_init(&heap->lock, NULL);
+  if (!heap_register(heap))
+    {
+      free_block(heap);
+      return (NULL);
+    }
+  return (heap);
+}
+
+/*
+** A zone for heap (no lock held): one of g_heap's retained empties if
+** the class has any, a new one otherwise. Tagged, but on no list yet.
+*/
+static t_slab *heap_slab_take(t_sea_heap *heap, int class_idx)
+{
+  t_slab *slab;
+
+  pthread_mutex_lock(&g_class_lock[class_idx].mutex);
+  if ((slab = g_heap.empty[class_idx]))
+    {
+      slab_unlink(class_list(class_idx, 2), slab);
+      g_heap.empty_count[class_idx]--;
+    }
+  pthread_mutex_unlock(&g_class_lock[class_idx].mutex);
+  if (!slab && !(slab = init_new_slab(class_idx < MAX_TINY_CLASSES ? 0 : 1,
+                                      class_idx, class_to_size(class_idx))))
+    return (NULL);
+  slab->heap_id = heap->id;
+  return (slab);
+}
+
+// Past SMALL: a page run from g_heap's chunks, tagged with the heap
+static void *heap_medium(t_sea_heap *heap, size_t size)
+{
+  void *ptr;
+
+  pthread_mutex_lock(&g_medium_lock.mutex);
+  if ((ptr = allocate_medium(size, NULL)))
+    pagemap_get(ptr)->heap_id = heap->id;
+  pthread_mutex_unlock(&g_medium_lock.mutex);
+  return (ptr);
+}
+
+// Past MEDIUM: a mapping of its own, never cached
+static void *heap_large(t_sea_heap *heap, size_t size)
+{
+  t_slab  *slab;
+  size_t  total_size;
+  void    *ptr;
+
+  if (size > SIZE_MAX - sizeof(t_slab) - PAGE_SIZE)
+    return (NULL);
+  total_size = (size + sizeof(t_slab) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+  slab = large_mmap(total_size);
+  if (slab == MAP_FAILED)
+    return (NULL);
+  slab->type = 2;
+  slab->block_size = size;
+  slab->total_blocks = 1;
+  slab->free_count = 0;
+  slab->heap_id = heap->id;
+  pthread_mutex_lock(&heap->lock);
+  ptr = large_register(slab);
+  pthread_mutex_unlock(&heap->lock);
+  return (ptr);
+}
+
+// sea_heap_alloc, untraced (a NULL heap is g_heap)
+void *heap_block(t_sea_heap *heap, size_t size)
+{
+  int     class_idx;
+  t_slab  **partial;
+  t_slab  *slab;
+  void    *ptr;
+
+  if (!heap)
+    return (malloc_block(size));
+  if (size == 0)
+    return (NULL);
+  if (size > g_conf.small_max)
+    return (size_type(size) == 3 ? heap_medium(heap, size)
+                                 : heap_large(heap, size));
+  class_idx = size_to_class(size);
+  partial = heap_class_list(&heap->heap, class_idx, 0);
+  pthread_mutex_lock(&heap->lock);
+  if (!(slab = *partial) && (slab = heap->heap.empty[class_idx]))
+    {
+      slab_unlink(&heap->heap.empty[class_idx], slab);
+      heap->heap.empty_count[class_idx]--;
+      slab_push(partial, slab);
+    }
+  if (!slab)
+    {
+      // class locks come before heap locks: never under ours
+      pthread_mutex_unlock(&heap->lock);
+      if (!(slab = heap_slab_take(heap, class_idx)))
+        return (NULL);
+      pthread_mutex_lock(&heap->lock);
+      slab_push(partial, slab);
+    }
+  alloc_from_slab(slab, &ptr, 1, NULL);
+  pthread_mutex_unlock(&heap->lock);
+  stats_count(class_idx, 1, false);
+  return (ptr);
+}
+
+__attribute__((visibility("default")))
+void *sea_heap_alloc(t_sea_heap *heap, size_t size)
+{
+  void *ptr;
+
+  ptr = heap_block(heap, size);
+  trace_op(TRACE_MALLOC, ptr, 0, size);
+  return (ptr);
+}
+
+// A trace still sees every block go: one free per block left in the slab
+static void heap_trace_frees(t_slab *slab)
+{
+  uint32_t  i;
+  uint64_t  used;
+
+  for (i = 0; i * 64 < slab->total_blocks; i++)
+    {
+      used = slab->bitmap[i];
+      if ((i + 1) * 64 > slab->total_blocks)
+        used &= ~(~0ULL << (slab->total_blocks % 64));
+      while (used)
+        {
+          trace_record(TRACE_FREE, slab_data(slab) + ((size_t)i * 64
+                       + __builtin_ctzll(used)) * slab->block_size, 0, 0, 0);
+          used &= used - 1;
+        }
+    }
+}
+
+/*
+** All of a destroyed heap's slab goes free in one go: the bitmap is
+** reset, not walked. Then it's g_heap's, kept as a retained empty if
+** the class has room for one.
+*/
+static void heap_slab_return(t_slab *slab)
+{
+  uint32_t  words;
+  uint32_t  i;
+  int       class_idx;
+
+  class_idx = slab->class_idx;
+  if (slab->free_count < slab->total_blocks)
+    {
+      stats_count(class_idx, slab->total_blocks - slab->free_count, true);
+      if (__atomic_load_n(&g_trace.on, __ATOMIC_RELAXED))
+        heap_trace_frees(slab);
+    }
+  words = (slab->total_blocks + 63) / 64;
+  for (i = 0; i < words; i++)
+    slab->bitmap[i] = 0;
+  if (slab->total_blocks % 64)
+    slab->bitmap[words - 1] = ~0ULL << (slab->total_blocks % 64);
+  slab->summary = (1U << words) - 1;
+  slab->free_count = slab->total_blocks;
+  slab->heap_id = 0;
+  slab->stamp = now_ms();
+  slab->advised = 0;
+  pthread_mutex_lock(&g_class_lock[class_idx].mutex);
+  if (g_heap.empty_count[class_idx]
+      < __atomic_load_n(&g_conf.slab_keep, __ATOMIC_RELAXED))
+    {
+      slab_push(class_list(class_idx, 2), slab);
+      g_heap.empty_count[class_idx]++;
+      slab = NULL;
+    }
+  pthread_mutex_unlock(&g_class_lock[class_idx].mutex);
+  if (slab)
+    slab_release(slab);
+}
+
+static void heap_large_release(t_slab *slab)
+{
+  if (__atomic_load_n(&g_trace.on, __ATOMIC_RELAXED))
+    trace_record(TRACE_FREE, slab + 1, 0, 0, 0);
+  pagemap_set(slab + 1, 1, NULL);
+  stat_add(&g_stats.large_nfree, 1);
+  stat_add(&g_stats.large_bytes, -(int64_t)large_map_size(slab));
+  heap_munmap(large_map_base(slab), large_map_size(slab));
+}
+
+// Move every slab of *head onto *chain (linked through next only)
+static void heap_detach(t_slab **chain, t_slab **head)
+{
+  t_slab *slab;
+
+  while ((slab = *head))
+    {
+      *head = slab->next;
+      slab->next = *chain;
+      *chain = slab;
+    }
+}
+
+/*
+** Free everything heap still holds, one sweep over its slabs rather than
+** one free per block. Its blocks must not be used (or freed) any more.
+*/
+__attribute__((visibility("default")))
+void sea_heap_destroy(t_sea_heap *heap)
+{
+  t_slab  *chain;
+  t_slab  *slab;
+  int     class_idx;
+  int     list;
+
+  if (!heap)
+    return;
+  chain = NULL;
+  pthread_mutex_lock(&heap->lock);
+  for (class_idx = 0; class_idx < NUM_SIZE_CLASSES; class_idx++)
+    for (list = 0; list < 3; list++)
+      heap_detach(&chain, heap_class_list(&heap->heap, class_idx, list));
+  heap_detach(&chain, &heap->heap.large);
+  pthread_mutex_unlock(&heap->lock);
+  pthread_mutex_lock(&g_medium_lock.mutex);
+  medium_release_heap(heap->id);
+  pthread_mutex_unlock(&g_medium_lock.mutex);
+  while ((slab = chain))
+    {
+      chain = slab->next;
+      if (slab->type == 2)
+        heap_large_release(slab);
+      else
+        heap_slab_return(slab);
+    }
+  heap_unregister(heap);
+  free_block(heap);
+}
+
+// After heap_lock_all: the registry, then every live heap
+void heaps_lock_all(void)
+{
+  uint32_t id;
+
+  pthread_mutex_lock(&g_heaps.lock);
+  for (id = 1; id <= g_heaps.next_id; id++)
+    if (g_heaps.table[id])
+      pthread_mutex_lock(&g_heaps.table[id]->lock);
+}
+
+void heaps_unlock_all(void)
+{
+  uint32_t id;
+
+  for (id = g_heaps.next_id; id >= 1; id--)
+    if (g_heaps.table[id])
+      pthread_mutex_unlock(&g_heaps.table[id]->lock);
+  pthread_mutex_unlock(&g_heaps.lock);
+}
+
+void heaps_fork_child(void)
+{
+  uint32_t id;
+
+  for (id = 1; id <= g_heaps.next_id; id++)
+    if (g_heaps.table[id])
+      pthread_mutex_init(&g_heaps.table[id]->lock, NULL);
+  pthread_mutex_init(&g_heaps.lock, NULL);
+}
@@ -0,0 +1,276 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: iterate.c                                                   */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 20:18:08 by espadara                              */
+/*      Updated: 2026/10/17 20:55:21 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+
+/*
+** A zone as the walk sees it: a slab with its bitmap, or (total_blocks
+** 0) a single block, a MEDIUM run or a LARGE mapping.
+*/
+typedef struct s_iter_zone
+{
+  char      *data;
+  void      *zone;
+  size_t    block_size;
+  uint32_t  total_blocks;
+  uint16_t  type;
+  uint16_t  class_idx;
+  uint32_t  heap_id;
+  uint64_t  bitmap[SLAB_MAX_BLOCKS / 64];
+}	t_iter_zone;
+
+typedef struct s_iter
+{
+  t_malloc_visit  visit;
+  void            *ctx;
+  size_t          visited;
+  bool            stop;
+  bool            snapshot;
+  t_iter_zone     *zones;     // snapshot: the copy, NULL while counting
+  size_t          nzones;
+  size_t          cap;
+}	t_iter;
+
+static void iter_visit(t_iter *it, t_malloc_block *block, char *ptr)
+{
+  block->ptr = ptr;
+  it->visited++;
+  if (!it->visit(block, it->ctx))
+    it->stop = true;
+}
+
+// Set bits only: the tail bits past total_blocks are set but no block
+static void iter_blocks(t_iter *it, const t_iter_zone *zone)
+{
+  t_malloc_block  block;
+  uint64_t        map;
+  uint32_t        words;
+  uint32_t        w;
+
+  block.size = zone->block_size;
+  block.zone = zone->zone;
+  block.type = zone->type;
+  block.class_idx = zone->type < 2 ? zone->class_idx : -1;
+  block.heap_id = zone->heap_id;
+  if (!zone->total_blocks)
+    {
+      iter_visit(it, &block, zone->data);
+      return;
+    }
+  words = (zone->total_blocks + 63) / 64;
+  for (w = 0; w < words && !it->stop; w++)
+    {
+      map = zone->bitmap[w];
+      if (w == words - 1 && zone->total_blocks % 64)
+        map &= (1ULL << (zone->total_blocks % 64)) - 1;
+      while (map && !it->stop)
+        {
+          iter_visit(it, &block, zone->data + ((size_t)w * 64
+                                               + __builtin_ctzll(map))
+                                              * zone->block_size);
+          map &= map - 1;
+        }
+    }
+}
+
+// Visited now, or copied (counted on the first snapshot pass)
+static void iter_zone(t_iter *it, const t_iter_zone *zone)
+{
+  if (!it->snapshot)
+    iter_blocks(it, zone);
+  else if (it->zones && it->nzones < it->cap)
+    it->zones[it->nzones++] = *zone;
+  else if (!it->zones)
+    it->nzones++;
+}
+
+static void iter_slabs(t_iter *it, t_slab *slab)
+{
+  t_iter_zone zone;
+
+  for (; slab && !it->stop; slab = slab->next)
+    {
+      if (slab->free_count == slab->total_blocks)
+        continue;
+      zone.data = slab_data(slab);
+      zone.zone = slab;
+      zone.block_size = slab->block_size;
+      zone.total_blocks = slab->total_blocks;
+      zone.type = slab->type;
+      zone.class_idx = slab->class_idx;
+      zone.heap_id = slab->heap_id;
+      sea_memcpy(zone.bitmap, slab->bitmap,
+                 (slab->total_blocks + 63) / 64 * sizeof(uint64_t));
+      iter_zone(it, &zone);
+    }
+}
+
+static void iter_single(t_iter *it, t_slab *slab, void *zone_base, char *ptr)
+{
+  t_iter_zone zone;
+
+  zone.data = ptr;
+  zone.zone = zone_base;
+  zone.block_size = slab->block_size;
+  zone.total_blocks = 0;
+  zone.type = slab->type;
+  zone.class_idx = 0;
+  zone.heap_id = slab->heap_id;
+  iter_zone(it, &zone);
+}
+
+static void iter_large(t_iter *it, t_slab *slab)
+{
+  for (; slab && !it->stop; slab = slab->next)
+    iter_single(it, slab, slab, (char *)(slab + 1));
+}
+
+static void iter_medium(t_iter *it)
+{
+  t_chunk *chunk;
+  t_slab  *run;
+  size_t  page;
+
+  for (chunk = g_heap.medium; chunk && !it->stop; chunk = chunk->next)
+    for (page = MEDIUM_FIRST_PAGE; page < MEDIUM_CHUNK_PAGES && !it->stop;
+         page += run->total_blocks)
+      {
+        run = chunk->runs[page];
+        if (run->free_count == 0)
+          iter_single(it, run, chunk, medium_run_addr(run));
+      }
+}
+
+static void iter_heaps(t_iter *it, bool lock)
+{
+  uint32_t    id;
+  int         i;
+  t_sea_heap  *heap;
+
+  if (lock)
+    pthread_mutex_lock(&g_heaps.lock);
+  for (id = 1; id <= g_heaps.next_id && !it->stop; id++)
+    {
+      if (!(heap = g_heaps.table[id]))
+        continue;
+      if (lock)
+        pthread_mutex_lock(&heap->lock);
+      for (i = 0; i < NUM_SIZE_CLASSES; i++)
+        {
+          iter_slabs(it, *heap_class_list(&heap->heap, i, 0));
+          iter_slabs(it, *heap_class_list(&heap->heap, i, 1));
+        }
+      iter_large(it, heap->heap.large);
+      if (lock)
+        pthread_mutex_unlock(&heap->lock);
+    }
+  if (lock)
+    pthread_mutex_unlock(&g_heaps.lock);
+}
+
+/*
+** Everything, in the walk's order. lock: take each lock around its own
+** part (live walk); otherwise the caller holds them all (snapshot).
+*/
+static void iter_walk(t_iter *it, bool lock, bool take_remote)
+{
+  int i;
+
+  for (i = 0; i < NUM_SIZE_CLASSES && !it->stop; i++)
+    {
+      if (lock)
+        pthread_mutex_lock(&g_class_lock[i].mutex);
+      if (take_remote)
+        remote_free_take(i, NULL, 0);
+      iter_slabs(it, *class_list(i, 0));
+      iter_slabs(it, *class_list(i, 1));
+      if (lock)
+        pthread_mutex_unlock(&g_class_lock[i].mutex);
+    }
+  if (lock)
+    pthread_mutex_lock(&g_medium_lock.mutex);
+  iter_medium(it);
+  if (lock)
+    {
+      pthread_mutex_unlock(&g_medium_lock.mutex);
+      pthread_mutex_lock(&g_large_lock.mutex);
+    }
+  iter_large(it, g_heap.large);
+  if (lock)
+    pthread_mutex_unlock(&g_large_lock.mutex);
+  iter_heaps(it, lock);
+}
+
+/*
+** Two passes under every lock: count the zones, map room for them, copy.
+** Zones only ever go away in between (a remote free emptying one), so
+** the count is enough. The copy is visited once the locks are dropped.
+*/
+static void iter_snapshot(t_iter *it)
+{
+  size_t  len;
+  size_t  i;
+
+  heap_lock_all();
+  heaps_lock_all();
+  iter_walk(it, false, true);
+  it->cap = it->nzones;
+  it->nzones = 0;
+  len = (it->cap * sizeof(t_iter_zone) + PAGE_SIZE - 1)
+        & ~((size_t)PAGE_SIZE - 1);
+  if (len && (it->zones = heap_mmap(len)) == MAP_FAILED)
+    it->zones = NULL;
+  if (it->zones)
+    iter_walk(it, false, false);
+  heaps_unlock_all();
+  heap_unlock_all();
+  for (i = 0; i < it->nzones && !it->stop; i++)
+    iter_blocks(it, &it->zones[i]);
+  if (it->zones)
+    heap_munmap(it->zones, len);
+}
+
+/*
+** Call visit(block, ctx) for every live block (see Heap walk), flags 0 or
+** SEA_MALLOC_SNAPSHOT. Returns how many blocks were visited; a snapshot
+** that can't get memory for its copy visits none.
+*/
+__attribute__((visibility("default")))
+size_t sea_malloc_iterate(t_malloc_visit visit, void *ctx, int flags)
+{
+  t_iter it;
+
+  if (!visit)
+    return (0);
+  sea_bzero(&it, sizeof(it));
+  it.visit = visit;
+  it.ctx = ctx;
+  it.snapshot = (flags & SEA_MALLOC_SNAPSHOT) != 0;
+  tcache_flush();
+  if (it.snapshot)
+    iter_snapshot(&it);
+  else
+    iter_walk(&it, true, true);
+  return (it.visited);
+}
@@ -0,0 +1,199 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: large_cache.c                                               */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 18:00:03 by espadara                              */
+/*      Updated: 2026/10/17 20:10:36 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+
+static inline int cache_bucket(size_t map_size)
+{
+  int bucket;
+
+  bucket = 63 - __builtin_clzll(map_size) - LARGE_CACHE_MIN_SHIFT;
+  if (bucket < 0)
+    return (0);
+  if (bucket >= LARGE_CACHE_BUCKETS)
+    return (LARGE_CACHE_BUCKETS - 1);
+  return (bucket);
+}
+
+static void cache_insert(t_slab *slab)
+{
+  int bucket = cache_bucket(large_map_size(slab));
+
+  slab->class_idx = bucket;
+  slab_push(&g_heap.cache_large[bucket], slab);
+  g_heap.cache_bins |= (1U << bucket);
+  g_heap.cache_bytes += large_map_size(slab);
+  g_heap.cache_count++;
+}
+
+static void cache_remove(t_slab *slab)
+{
+  int bucket = slab->class_idx;
+
+  slab_unlink(&g_heap.cache_large[bucket], slab);
+  if (!g_heap.cache_large[bucket])
+    g_heap.cache_bins &= ~(1U << bucket);
+  g_heap.cache_bytes -= large_map_size(slab);
+  g_heap.cache_count--;
+}
+
+static void cache_evict(t_slab *slab)
+{
+  cache_remove(slab);
+  heap_munmap(slab, large_map_size(slab));
+}
+
+/*
+** Best fit for a mapping of map_size bytes: smallest entry that fits in
+** the request's own bucket, else the smallest one of the next bucket up.
+** Too much slack gets cut off: kept as its own entry if it's still a
+** LARGE sized mapping, handed back to the kernel otherwise.
+*/
+t_slab *large_cache_take(size_t map_size)
+{
+  uint32_t  bins;
+  t_slab    *slab;
+  t_slab    *best;
+  size_t    have;
+  t_slab    *tail;
+
+  best = NULL;
+  bins = g_heap.cache_bins & (~0U << cache_bucket(map_size));
+  while (bins && !best)
+    {
+      for (slab = g_heap.cache_large[__builtin_ctz(bins)]; slab; slab = slab->next)
+        if (large_map_size(slab) >= map_size
+            && (!best || large_map_size(slab) < large_map_size(best)))
+          best = slab;
+      bins &= bins - 1;
+    }
+  if (!best)
+    return (NULL);
+  cache_remove(best);
+  have = large_map_size(best);
+  if (have - map_size > map_size / 8)
+    {
+      best->block_size = map_size - sizeof(t_slab);
+      tail = (t_slab *)((char *)best + map_size);
+      if (have - map_size >= (1UL << LARGE_CACHE_MIN_SHIFT))
+        {
+          tail->type = 2;
+          tail->total_blocks = 1;
+          tail->free_count = 0;
+          tail->block_size = have - map_size - sizeof(t_slab);
+          tail->stamp = best->stamp;
+          tail->advised = best->advised;
+          tail->sampled_more = 0;
+          tail->sampled_at = 0;
+          tail->heap_id = 0;
+          cache_insert(tail);
+        }
+      else
+        heap_munmap(tail, have - map_size);
+    }
+  return (best);
+}
+
+// Oldest entry of the whole cache
+static t_slab *cache_oldest(uint32_t now)
+{
+  int       bucket;
+  t_slab    *slab;
+  t_slab    *oldest;
+
+  oldest = NULL;
+  for (bucket = 0; bucket < LARGE_CACHE_BUCKETS; bucket++)
+    for (slab = g_heap.cache_large[bucket]; slab; slab = slab->next)
+      if (!oldest || now - slab->stamp > now - oldest->stamp)
+        oldest = slab;
+  return (oldest);
+}
+
+// false: not worth caching, caller unmaps it
+bool large_cache_put(t_slab *slab)
+{
+  size_t    map_size;
+  size_t    budget;
+  uint32_t  now;
+
+  map_size = large_map_size(slab);
+  budget = __atomic_load_n(&g_conf.large_cache, __ATOMIC_RELAXED);
+  if (map_size > budget / 2)
+    return (false);
+  now = now_ms();
+  while (g_heap.cache_bytes + map_size > budget)
+    cache_evict(cache_oldest(now));
+  slab->stamp = now;
+  slab->advised = 0;
+  cache_insert(slab);
+  return (true);
+}
+
+// Unmap entries, oldest first, until at most keep bytes are cached
+size_t large_cache_trim(size_t keep)
+{
+  size_t    released;
+  uint32_t  now;
+  t_slab    *slab;
+
+  released = 0;
+  now = now_ms();
+  while (g_heap.cache_bytes > keep && (slab = cache_oldest(now)))
+    {
+      released += large_map_size(slab);
+      cache_evict(slab);
+    }
+  return (released);
+}
+
+void large_cache_decay(uint32_t now, bool force)
+{
+  int       bucket;
+  t_slab    *slab;
+  t_slab    *next;
+  uint32_t  idle;
+  uint32_t  decay;
+
+  decay = (uint32_t)__atomic_load_n(&g_conf.decay_ms, __ATOMIC_RELAXED);
+  for (bucket = 0; bucket < LARGE_CACHE_BUCKETS; bucket++)
+    {
+      slab = g_heap.cache_large[bucket];
+      while (slab)
+        {
+          next = slab->next;
+          idle = now - slab->stamp;
+          if (force || idle >= 2 * decay)
+            cache_evict(slab);
+          else if (idle >= decay && !slab->advised)
+            {
+              // everything past the header page
+              if (large_map_size(slab) > PAGE_SIZE)
+                madvise_free((char *)slab + PAGE_SIZE,
+                             large_map_size(slab) - PAGE_SIZE);
+              slab->advised = 1;
+            }
+          slab = next;
+        }
+    }
+}
@@ -1,226 +1,620 @@
-/* ************************************************************************** */
-/*                                                                            */
-/*                        ______                                              */
-/*                     .-"      "-.                                           */
-/*                    /            \                                          */
-/*        _          |              |          _                              */
-/*       ( \         |,  .-.  .-.  ,|         / )                             */
-/*        > "=._     | )(__/  \__)( |     _.=" <                              */
-/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
-/*              "=._ (_     ^^     _)"_.="                                    */
-/*                  "=\__|IIIIII|__/="                                        */
-/*                 _.="| \IIIIII/ |"=._                                       */
-/*       _     _.="_.="\          /"=._"=._     _                             */
-/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
-/*       > _.="                            "=._ <                             */
-/*      (_/                                    \_)                            */
-/*                                                                            */
-/*      Filename: malloc.c                                                    */
-/*      By: espadara <espadara@pirate.capn.gg>                                */
-/*      Created: 2025/11/11 22:36:00 by espadara                              */
-/*      Updated: 2025/11/23 17:51:05 by espadara                              */
-/*                                                                            */
-/* ************************************************************************** */
-
-#include "sea_malloc.h"
-
-t_heap g_heap = {0};
-
-pthread_mutex_t g_malloc_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-static inline int get_class_index(size_t size)
-{
-  if (size == 0)
-    return (0);
-  // Size 1-16 -> index 0 | size 17-32 -> index 1 etc.
-  return ((size -1) / MIN_ALIGNMENT);
-}
-
-static t_slab *init_new_slab(int type, int class_index, size_t block_size)
-{
-  t_slab *slab;
-  size_t zone_size;
-  size_t available_bytes;
-  t_slab **head;
-
-  if (type == 0)// TINY
-    {
-      zone_size = TINY_ZONE_SIZE;
-      head = &g_heap.tiny[class_index];
-    }
- else // SMALL
-   {
-     zone_size = SMALL_ZONE_SIZE;
-     head = &g_heap.small[class_index];
-   }
-
-  slab = mmap(NULL, zone_size, PROT_READ | PROT_WRITE,
-              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-  if (slab == MAP_FAILED)
-    return (NULL);
-
-  slab->block_size = block_size;
-  available_bytes = zone_size - sizeof(t_slab);
-  slab->total_blocks = available_bytes / block_size;
-
-  if (slab->total_blocks > 1024)
-    slab->total_blocks = 1024;
-
-  slab->free_count = slab->total_blocks;
-  slab->prev = NULL;
-
-  // Insert to the front of Global Heap
-  slab->next = *head;
-  if (*head)
-    (*head)->prev = slab;
-  *head = slab;
-
-  return (slab);
-}
-
-static void *alloc_from_slab(t_slab *slab)
-{
-  int i;
-  uint64_t inverted;
-  int bit_pos;
-  size_t global_pos;
-
-  for (i = 0; i < 16; i++)
-    {
-      // UINT64_MAX -> ALL BITS ARE (1)
-      if (slab->bitmap[i] != UINT64_MAX)
-        {
-          // Invert to find first (0)
-          inverted = ~slab->bitmap[i];
-          // __builtin_ffsll: Built-in CPU instruction to find index of first set bit
-          bit_pos = __builtin_ffsll(inverted) - 1; // 0 - 63
-
-          // Mark bit as used (1)
-          slab->bitmap[i] |= (1ULL << bit_pos);
-          slab->free_count--;
-
-          //Adress = slab_start + header_size + (block_index * block_size)
-          global_pos =  (i * 64) + bit_pos;
-
-          /* [ SLAB HEADER ] [ BLOCK 0 ] [ BLOCK 1 ] [ BLOCK 2 ] [ BLOCK 3 ] ...
-          ** ^               ^           ^           ^
-          ** |               |           |           |
-          ** Start (slab)    |           |           Target (Block 2)
-          **                 |           |
-          **                 End of Header
-          */
-          return ((void *) ((char *)slab +
-                            sizeof(t_slab) + (global_pos * slab->block_size)));
-        }
-    }
-  return (NULL);
-}
-
-static void *allocate_tiny_small(size_t size, int type)
-  {
-    int class_idx;
-    size_t aligned_size;
-    t_slab *slab;
-
-    class_idx = get_class_index(size);
-
-    // get true block size. Example: 17 -> aligned to 32
-    aligned_size = (class_idx + 1) * MIN_ALIGNMENT;
-
-    if (type == 0)
-      slab = g_heap.tiny[class_idx];
-    else
-      slab = g_heap.small[class_idx];
-
-    while (slab)
-      {
-        if (slab->free_count > 0)
-          return (alloc_from_slab(slab));
-        slab = slab->next;
-      }
-
-    // in case of not enough space -> create new zone
-    if (!(slab = init_new_slab(type, class_idx, aligned_size)))
-      {
-        sea_printf("Failed to allocate new zone\n");
-        return (NULL);
-      }
-
-    return (alloc_from_slab(slab));
-}
-
-static void *allocate_large(size_t size)
-{
-  t_slab	*slab;
-  t_slab	*cache;
-  size_t	total_size;
-
-  cache = g_heap.cache_large;
-  while (cache)
-    {
-      if (cache->block_size >= size)
-        {
-          // Found a suitable cached block! Unlink it from cache
-          if (cache->prev)
-            cache->prev->next = cache->next;
-          else
-            g_heap.cache_large = cache->next;
-          if (cache->next)
-            cache->next->prev = cache->prev;
-          g_heap.cache_count--;
-          // Add to active large list
-          cache->next = g_heap.large;
-          cache->prev = NULL;
-          if (g_heap.large)
-            g_heap.large->prev = cache;
-          g_heap.large = cache;
-          return ((void *)(cache + 1));
-        }
-      cache = cache->next;
-    }
-  
-  total_size = size + sizeof(t_slab);
-
-  total_size = (total_size + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1);
-
-    slab = mmap(NULL, total_size, PROT_READ | PROT_WRITE,
-                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (slab == MAP_FAILED)
-      {
-        sea_printf("Failed to allocate large block");
-        return (NULL);
-      }
-
-    slab->block_size = size;
-    slab->total_blocks = 1;
-    slab->free_count = 0;
-
-    slab->next = g_heap.large;
-    slab->prev = NULL;
-    if (g_heap.large)
-      g_heap.large->prev = slab;
-    g_heap.large = slab;
-
-    // return the pointer right after header
-    return ((void *)(slab + 1));
-}
-
-__attribute__((visibility("default")))
-void *sea_malloc(size_t size)
-{
-  void *ptr;
-
-  if (size == 0)
-    return (NULL);
-  pthread_mutex_lock(&g_malloc_mutex);
-
-  if (size <= TINY_BLOCK_MAX)
-    ptr = allocate_tiny_small(size, 0); // 0 = TINY
-  else if (size <= SMALL_BLOCK_MAX)
-    ptr = allocate_tiny_small(size, 1); // 1 = SMALL
-  else
-    ptr = allocate_large(size); // LARGE
-
-  pthread_mutex_unlock(&g_malloc_mutex);
-  return (ptr);
-}
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: malloc.c                                                    */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2025/11/11 22:36:00 by espadara                              */
+/*      Updated: 2026/10/17 21:40:06 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+
+t_heap g_heap = {0};
+
+t_lock g_class_lock[NUM_SIZE_CLASSES] = {
+  [0 ... NUM_SIZE_CLASSES - 1] = {PTHREAD_MUTEX_INITIALIZER}
+};
+t_lock g_medium_lock = {PTHREAD_MUTEX_INITIALIZER};
+t_lock g_large_lock = {PTHREAD_MUTEX_INITIALIZER};
+
+/*
+** Colour of a new zone: how far its blocks move past class_data_offset,
+** round-robin over the room the tail leaves (none when it's too short).
+*/
+static size_t slab_colour(size_t room, size_t block_size)
+{
+  size_t  step;
+
+  if (room > SLAB_COLOUR_MAX)
+    room = SLAB_COLOUR_MAX;
+  step = class_align(block_size);
+  if (step < SLAB_COLOUR_STEP)
+    step = SLAB_COLOUR_STEP;
+  if (room < step)
+    return (0);
+  return (__atomic_fetch_add(&g_heap.colour_next, 1, __ATOMIC_RELAXED)
+          % (room / step + 1) * step);
+}
+
+t_slab *init_new_slab(int type, int class_index, size_t block_size)
+{
+  t_slab *slab;
+  size_t zone_size;
+  size_t map_size;
+  size_t available_bytes;
+
+  zone_size = class_zone_size(class_index);
+  map_size = zone_size;
+
+  slab = zone_mmap(&map_size);
+  if (slab == MAP_FAILED)
+    return (NULL);
+  if (!pagemap_set(slab, map_size, slab))
+    {
+      pagemap_set(slab, map_size, NULL);
+      heap_munmap(slab, map_size);
+      return (NULL);
+    }
+  stat_add(&g_stats.slabs[class_index], 1);
+  stat_add(&g_stats.zone_bytes[class_index], map_size);
+
+  slab->type = type;
+  slab->class_idx = class_index;
+  slab->zone_pages = map_size / PAGE_SIZE;
+  slab->block_size = block_size;
+  slab->data_offset = class_data_offset(block_size);
+  available_bytes = zone_size - slab->data_offset;
+  slab->total_blocks = available_bytes / block_size;
+
+  if (slab->total_blocks > SLAB_MAX_BLOCKS)
+    slab->total_blocks = SLAB_MAX_BLOCKS;
+  slab->data_offset += slab_colour(map_size - slab->data_offset
+                                   - slab->total_blocks * block_size,
+                                   block_size);
+
+  slab->free_count = slab->total_blocks;
+  // One summary bit per bitmap word in use, tail bits of the last word taken
+  slab->summary = (1U << ((slab->total_blocks + 63) / 64)) - 1;
+  if (slab->total_blocks % 64)
+    slab->bitmap[slab->total_blocks / 64] = ~0ULL << (slab->total_blocks % 64);
+  return (slab);
+}
+
+/*
+** Up to count blocks from one slab. ctz(summary) finds a word with room,
+** then every free bit of it we need is taken with a single store, so a
+** batch costs one bitmap write per word rather than per block.
+*/
+size_t alloc_from_slab(t_slab *slab, void **out, size_t count, bool *zeroed)
+{
+  int       i;
+  uint64_t  avail;
+  uint64_t  taken;
+  uint64_t  bit;
+  size_t    n;
+
+  n = 0;
+  while (n < count && slab->summary)
+    {
+      i = __builtin_ctz(slab->summary);
+      // Invert to find the (0)s
+      avail = ~slab->bitmap[i];
+      taken = 0;
+      while (avail && n < count)
+        {
+          bit = avail & -avail;
+          avail ^= bit;
+          taken |= bit;
+          /* [ SLAB HEADER ]..[ BLOCK 0 ] [ BLOCK 1 ] [ BLOCK 2 ] ...
+          ** ^                 ^                       ^
+          ** Start (slab)      data_offset (aligned)   Target (Block 2)
+          */
+          out[n++] = slab_data(slab)
+                     + ((size_t)i * 64 + __builtin_ctzll(bit)) * slab->block_size;
+        }
+      // Mark bits as used (1); UINT64_MAX -> ALL BITS ARE (1)
+      slab->bitmap[i] |= taken;
+      if (slab->bitmap[i] == UINT64_MAX)
+        slab->summary &= ~(1U << i);
+    }
+  slab->free_count -= n;
+  // out[0] has the lowest index of the lot, out[n - 1] the highest
+  if (n && zeroed && (char *)out[0] < slab_data(slab)
+      + (size_t)slab->fresh * slab->block_size)
+    *zeroed = false;
+  if (n && (char *)out[n - 1] >= slab_data(slab)
+      + (size_t)slab->fresh * slab->block_size)
+    slab->fresh = ((char *)out[n - 1] - slab_data(slab)) / slab->block_size + 1;
+  if (slab->free_count == 0)
+    {
+      slab_unlink(heap_class_list(slab_heap(slab), slab->class_idx, 0), slab);
+      slab_push(heap_class_list(slab_heap(slab), slab->class_idx, 1), slab);
+    }
+  return (n);
+}
+
+/*
+** Hand out up to `count` blocks of the class serving `size`.
+** Used with count = 1 by the locked path and with tcache_batch by tcache
+** refills, so a whole batch costs one lock round-trip.
+** zeroed (if not NULL) is cleared unless every block is still untouched.
+*/
+size_t allocate_tiny_small_batch(size_t size, void **out, size_t count,
+                                 bool *zeroed)
+{
+  int     type;
+  int     class_idx;
+  size_t  aligned_size;
+  t_slab  *slab;
+  size_t  n;
+
+  type = (size <= TINY_BLOCK_MAX) ? 0 : 1;
+  class_idx = size_to_class(size);
+
+  // get true block size. Example: 17 -> 32, 1000 -> 1024
+  aligned_size = class_to_size(class_idx);
+
+  // blocks other threads freed come first, no bitmap work at all
+  n = remote_free_take(class_idx, out, count);
+  if (n && zeroed)
+    *zeroed = false;
+  while (n < count)
+    {
+      // head of the partial list always has room
+      slab = *class_list(class_idx, 0);
+      // then a reserved zone, already faulted in
+      if (!slab && (slab = g_heap.reserve[class_idx]))
+        {
+          slab_unlink(&g_heap.reserve[class_idx], slab);
+          slab_push(class_list(class_idx, 0), slab);
+        }
+      // then a retained empty zone (pages fault back in if advised)
+      if (!slab && (slab = *class_list(class_idx, 2)))
+        {
+          slab_unlink(class_list(class_idx, 2), slab);
+          g_heap.empty_count[class_idx]--;
+          slab_push(class_list(class_idx, 0), slab);
+        }
+      // in case of not enough space -> create new zone
+      if (!slab)
+        {
+          if (!(slab = init_new_slab(type, class_idx, aligned_size)))
+            break;
+          slab_push(class_list(class_idx, 0), slab);
+        }
+      n += alloc_from_slab(slab, out + n, count - n, zeroed);
+    }
+  return (n);
+}
+
+// Publish a LARGE header: page map entry for the user page, active list
+void *large_register(t_slab *slab)
+{
+  if (!pagemap_set(slab + 1, 1, slab))
+    {
+      heap_munmap(large_map_base(slab), large_map_size(slab));
+      return (NULL);
+    }
+  stat_add(&g_stats.large_nmalloc, 1);
+  stat_add(&g_stats.large_bytes, large_map_size(slab));
+
+  slab->next = slab_heap(slab)->large;
+  slab->prev = NULL;
+  if (slab->next)
+    slab->next->prev = slab;
+  slab_heap(slab)->large = slab;
+
+  // return the pointer right after header
+  return ((void *)(slab + 1));
+}
+
+// dirty (if not NULL): set when the block may hold old data (cache hit)
+static void *allocate_large(size_t size, bool *dirty)
+{
+  t_slab	*slab;
+  size_t	total_size;
+
+  if (size > SIZE_MAX - sizeof(t_slab) - PAGE_SIZE)
+    return (NULL);
+  total_size = size + sizeof(t_slab);
+
+  total_size = (total_size + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1);
+
+  // Found a suitable cached block? (best fit, slack already cut off)
+  if ((slab = large_cache_take(total_size)))
+    {
+      if (large_map_size(slab) == total_size)
+        slab->block_size = size;
+      if (dirty)
+        *dirty = true;
+    }
+  else
+    {
+      slab = large_mmap(total_size);
+      if (slab == MAP_FAILED)
+        return (NULL);
+      slab->type = 2;
+      slab->class_idx = 0;
+      slab->block_size = size;
+      slab->total_blocks = 1;
+      slab->free_count = 0;
+      if (dirty)
+        *dirty = false;
+    }
+  return (large_register(slab));
+}
+
+/*
+** LARGE block whose user pointer is a multiple of align (>= PAGE_SIZE).
+** Over-map by align, put the pointer on the first aligned address past
+** one page, the header at the end of that page, and trim both ends.
+**
+**   [ trimmed ] [ ... HEADER ] [ USER (aligned) ... ] [ trimmed ]
+**               ^ base         ^ ptr
+*/
+static void *allocate_large_aligned(size_t size, size_t align)
+{
+  char    *raw;
+  char    *ptr;
+  size_t  len;
+  size_t  map_size;
+  t_slab  *slab;
+
+  if (size > SIZE_MAX - align - 2 * PAGE_SIZE)
+    return (NULL);
+  len = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+  map_size = len + align;
+  raw = heap_mmap(map_size);
+  if (raw == MAP_FAILED)
+    return (NULL);
+  ptr = (char *)(((uintptr_t)raw + PAGE_SIZE + align - 1)
+                 & ~(uintptr_t)(align - 1));
+  if (ptr - PAGE_SIZE > raw)
+    heap_munmap(raw, ptr - PAGE_SIZE - raw);
+  if (ptr + len < raw + map_size)
+    heap_munmap(ptr + len, raw + map_size - (ptr + len));
+
+  slab = (t_slab *)ptr - 1;
+  slab->type = 2;
+  slab->class_idx = 0;
+  slab->block_size = size;
+  slab->total_blocks = 1;
+  slab->free_count = 0;
+  slab->advised = 0;
+  return (large_register(slab));
+}
+
+/*
+** Up to a page, an aligned block is a plain class block: the first class
+** (no smaller than the request) whose size is a multiple of alignment is
+** aligned to it (see class_align), so there is no padding to waste and
+** the thread cache serves it like any other. Past SMALL, MEDIUM runs are
+** page aligned; past a page, the LARGE mapping is trimmed to fit.
+*/
+static void *aligned_block(size_t alignment, size_t size)
+{
+  int   class_idx;
+  int   type;
+  void  *ptr;
+
+  if (alignment <= MIN_ALIGNMENT)
+    return (malloc_block(size));
+  if (size == 0)
+    return (NULL);
+  conf_boot();
+  type = size_type(size);
+  if (alignment <= PAGE_SIZE && type < 2)
+    {
+      class_idx = size_to_class(size < alignment ? alignment : size);
+      while (class_to_size(class_idx) <= g_conf.small_max
+             && class_to_size(class_idx) % alignment)
+        class_idx++;
+      if (class_to_size(class_idx) <= g_conf.small_max)
+        return (malloc_block(class_to_size(class_idx)));
+      type = 3;
+    }
+  if (alignment <= PAGE_SIZE && type == 3)
+    {
+      pthread_mutex_lock(&g_medium_lock.mutex);
+      ptr = allocate_medium(size, NULL);
+      pthread_mutex_unlock(&g_medium_lock.mutex);
+    }
+  else
+    {
+      pthread_mutex_lock(&g_large_lock.mutex);
+      ptr = allocate_large_aligned(size, alignment < PAGE_SIZE
+                                   ? PAGE_SIZE : alignment);
+      pthread_mutex_unlock(&g_large_lock.mutex);
+    }
+  prof_account(ptr, size);
+  return (ptr);
+}
+
+__attribute__((visibility("default")))
+void *sea_aligned_alloc(size_t alignment, size_t size)
+{
+  void *ptr;
+
+  if (!alignment || (alignment & (alignment - 1)))
+    return (NULL);
+  ptr = aligned_block(alignment, size);
+  trace_op(TRACE_ALIGNED, ptr, alignment, size);
+  return (ptr);
+}
+
+// Legacy flavour: an alignment that isn't a power of two is rounded up
+__attribute__((visibility("default")))
+void *sea_memalign(size_t alignment, size_t size)
+{
+  if (alignment > ((size_t)1 << (sizeof(size_t) * 8 - 1)))
+    return (NULL);
+  if (alignment > 1 && (alignment & (alignment - 1)))
+    alignment = (size_t)1 << (sizeof(size_t) * 8 - __builtin_clzl(alignment));
+  return (sea_aligned_alloc(alignment ? alignment : 1, size));
+}
+
+// Lock of the class / tier a request of size bytes is served from
+static pthread_mutex_t *size_lock(int type, size_t size)
+{
+  if (type < 2)
+    return (&g_class_lock[size_to_class(size)].mutex);
+  if (type == 3)
+    return (&g_medium_lock.mutex);
+  return (&g_large_lock.mutex);
+}
+
+// sea_malloc, untraced: what the other entry points allocate with
+void *malloc_block(size_t size)
+{
+  void            *ptr;
+  pthread_mutex_t *lock;
+  int             type;
+
+  if (size == 0)
+    return (NULL);
+  conf_boot();
+  // Fast path: thread cache, no lock
+  if (size <= __atomic_load_n(&g_conf.tcache_max, __ATOMIC_RELAXED)
+      && (ptr = tcache_alloc(size)))
+    {
+      prof_account(ptr, size);
+      return (ptr);
+    }
+
+  // Only the lock of the tier (or class) we allocate from
+  type = size_type(size);
+  lock = size_lock(type, size);
+  pthread_mutex_lock(lock);
+
+  if (type < 2)
+    {
+      if (!allocate_tiny_small_batch(size, &ptr, 1, NULL)) // TINY or SMALL
+        ptr = NULL;
+    }
+  else if (type == 3)
+    ptr = allocate_medium(size, NULL); // MEDIUM
+  else
+    ptr = allocate_large(size, NULL); // LARGE
+
+  pthread_mutex_unlock(lock);
+  if (ptr && type < 2)
+    stats_count(size_to_class(size), 1, false);
+  // frees don't always take a lock, so decay gets its turn here too
+  slab_decay(false);
+  prof_account(ptr, size);
+  return (ptr);
+}
+
+__attribute__((visibility("default")))
+void *sea_malloc(size_t size)
+{
+  void *ptr;
+
+  ptr = malloc_block(size);
+  trace_op(TRACE_MALLOC, ptr, 0, size);
+  return (ptr);
+}
+
+/*
+** Clear [ptr, ptr + len). Whole pages of a big range are dropped instead
+** (MADV_DONTNEED: they fault back in as zero pages) so a recycled
+** mapping isn't made resident just to be wiped.
+*/
+static void zero_range(char *ptr, size_t len)
+{
+  char  *start;
+  char  *end;
+
+  start = (char *)(((uintptr_t)ptr + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1));
+  end = (char *)((uintptr_t)(ptr + len) & ~(uintptr_t)(PAGE_SIZE - 1));
+  if (end > start && (size_t)(end - start) >= LARGE_ZERO_MADVISE
+      && madvise(start, end - start, MADV_DONTNEED) == 0)
+    {
+      sea_bzero_fast(ptr, start - ptr);
+      sea_bzero_fast(end, ptr + len - end);
+      return;
+    }
+  sea_bzero_fast(ptr, len);
+}
+
+/*
+** calloc's allocation: only memory that may hold old data gets cleared.
+** Fresh LARGE mappings, MEDIUM pages past their chunk's high-water mark
+** and slab blocks past their slab's are still the kernel's zero pages
+** and are left alone (and non-resident).
+** Up to tcache_max the thread cache still wins: its blocks are hot
+** and clearing 1 KB is cheaper than a lock round-trip.
+*/
+void *malloc_zeroed(size_t size)
+{
+  void            *ptr;
+  bool            zeroed;
+  bool            recycled;
+  size_t          dirty;
+  pthread_mutex_t *lock;
+  int             type;
+
+  if (size == 0)
+    return (NULL);
+  conf_boot();
+  if (size <= __atomic_load_n(&g_conf.tcache_max, __ATOMIC_RELAXED)
+      && (ptr = tcache_alloc(size)))
+    {
+      sea_bzero_fast(ptr, size);
+      prof_account(ptr, size);
+      return (ptr);
+    }
+  type = size_type(size);
+  lock = size_lock(type, size);
+  pthread_mutex_lock(lock);
+  if (type < 2)
+    {
+      zeroed = true;
+      if (!allocate_tiny_small_batch(size, &ptr, 1, &zeroed))
+        ptr = NULL;
+      dirty = zeroed ? 0 : size;
+    }
+  else if (type == 3)
+    ptr = allocate_medium(size, &dirty);
+  else
+    {
+      recycled = false;
+      ptr = allocate_large(size, &recycled);
+      dirty = recycled ? size : 0;
+    }
+  pthread_mutex_unlock(lock);
+  if (ptr && type < 2)
+    stats_count(size_to_class(size), 1, false);
+  slab_decay(false);
+  if (ptr && dirty)
+    zero_range(ptr, dirty < size ? dirty : size);
+  prof_account(ptr, size);
+  return (ptr);
+}
+
+/*
+** count blocks of size bytes in out, for one lock round-trip. TINY/SMALL
+** fill whole bitmap words at a time (see alloc_from_slab).
+** Returns how many were allocated, fewer only when memory ran out.
+*/
+__attribute__((visibility("default")))
+size_t sea_malloc_batch(size_t size, size_t count, void **out)
+{
+  size_t          n;
+  size_t          i;
+  pthread_mutex_t *lock;
+  int             type;
+
+  if (size == 0 || !out)
+    return (0);
+  conf_boot();
+  type = size_type(size);
+  lock = size_lock(type, size);
+  pthread_mutex_lock(lock);
+  if (type < 2)
+    n = allocate_tiny_small_batch(size, out, count, NULL);
+  else
+    {
+      for (n = 0; n < count; n++)
+        {
+          out[n] = (type == 3) ? allocate_medium(size, NULL)
+                               : allocate_large(size, NULL);
+          if (!out[n])
+            break;
+        }
+    }
+  pthread_mutex_unlock(lock);
+  if (n && type < 2)
+    stats_count(size_to_class(size), n, false);
+  slab_decay(false);
+  for (i = 0; i < n; i++)
+    {
+      prof_account(out[i], size);
+      trace_op(TRACE_MALLOC, out[i], 0, size);
+    }
+  return (n);
+}
+
+// Classes ascending, then MEDIUM, then LARGE: the one global lock order
+void heap_lock_all(void)
+{
+  int i;
+
+  for (i = 0; i < NUM_SIZE_CLASSES; i++)
+    pthread_mutex_lock(&g_class_lock[i].mutex);
+  pthread_mutex_lock(&g_medium_lock.mutex);
+  pthread_mutex_lock(&g_large_lock.mutex);
+}
+
+void heap_unlock_all(void)
+{
+  int i;
+
+  pthread_mutex_unlock(&g_large_lock.mutex);
+  pthread_mutex_unlock(&g_medium_lock.mutex);
+  for (i = NUM_SIZE_CLASSES - 1; i >= 0; i--)
+    pthread_mutex_unlock(&g_class_lock[i].mutex);
+}
+
+/*
+** fork() from a threaded program: hold every lock across it so the child
+** never inherits a heap that another thread was halfway through changing.
+*/
+static void fork_prepare(void)
+{
+  heap_lock_all();
+  heaps_lock_all();
+  thp_fork_prepare();
+  purge_fork_prepare();
+  stats_fork_prepare();
+  prof_fork_prepare();
+  trace_fork_prepare();
+}
+
+static void fork_parent(void)
+{
+  trace_fork_parent();
+  prof_fork_parent();
+  stats_fork_parent();
+  purge_fork_parent();
+  thp_fork_parent();
+  heaps_unlock_all();
+  heap_unlock_all();
+}
+
+static void fork_child(void)
+{
+  int i;
+
+  for (i = 0; i < NUM_SIZE_CLASSES; i++)
+    pthread_mutex_init(&g_class_lock[i].mutex, NULL);
+  pthread_mutex_init(&g_medium_lock.mutex, NULL);
+  pthread_mutex_init(&g_large_lock.mutex, NULL);
+  heaps_fork_child();
+  thp_fork_child();
+  purge_fork_child();
+  stats_fork_child();
+  prof_fork_child();
+  trace_fork_child();
+}
+
+__attribute__((constructor))
+static void malloc_atfork_init(void)
+{
+  pthread_atfork(fork_prepare, fork_parent, fork_child);
+}
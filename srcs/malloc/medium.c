@@ -0,0 +1,402 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: medium.c                                                    */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 17:46:50 by espadara                              */
+/*      Updated: 2026/10/17 21:56:53 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+
+void *medium_run_addr(t_slab *run)
+{
+  return ((char *)run->chunk + (size_t)run->data_offset * PAGE_SIZE);
+}
+
+// A run descriptor off the pool, zeroed; the pool grows by a mapping
+static t_slab *desc_new(void)
+{
+  t_slab  *run;
+  t_slab  *more;
+  size_t  i;
+
+  if (!g_heap.medium_desc)
+    {
+      more = heap_mmap(MEDIUM_DESC_MAP);
+      if (more == MAP_FAILED)
+        return (NULL);
+      for (i = 0; i < MEDIUM_DESC_MAP / sizeof(t_slab); i++)
+        {
+          more[i].next = g_heap.medium_desc;
+          g_heap.medium_desc = &more[i];
+        }
+    }
+  run = g_heap.medium_desc;
+  g_heap.medium_desc = run->next;
+  sea_bzero(run, sizeof(*run));
+  return (run);
+}
+
+static void desc_free(t_slab *run)
+{
+  run->next = g_heap.medium_desc;
+  g_heap.medium_desc = run;
+}
+
+static inline size_t bin_index(size_t npages)
+{
+  if (npages >= MEDIUM_BINS)
+    return (MEDIUM_BINS - 1);
+  return (npages - 1);
+}
+
+static void bin_insert(t_slab *run)
+{
+  size_t idx = bin_index(run->total_blocks);
+
+  run->class_idx = idx;
+  run->prev = NULL;
+  run->next = g_heap.medium_free[idx];
+  if (run->next)
+    run->next->prev = run;
+  g_heap.medium_free[idx] = run;
+  g_heap.medium_bins[idx / 64] |= (1ULL << (idx % 64));
+}
+
+static void bin_remove(t_slab *run)
+{
+  size_t idx = run->class_idx;
+
+  if (run->prev)
+    run->prev->next = run->next;
+  else
+    g_heap.medium_free[idx] = run->next;
+  if (run->next)
+    run->next->prev = run->prev;
+  if (!g_heap.medium_free[idx])
+    g_heap.medium_bins[idx / 64] &= ~(1ULL << (idx % 64));
+}
+
+// Tag [page, page + npages) as run, one free run, and bin it
+static void set_free_run(t_chunk *chunk, t_slab *run, size_t page,
+                         size_t npages)
+{
+  run->type = 3;
+  run->chunk = chunk;
+  run->data_offset = page;
+  run->total_blocks = npages;
+  run->block_size = npages * PAGE_SIZE;
+  run->free_count = 1;
+  run->advised = 0;
+  run->heap_id = 0;
+  chunk->runs[page] = run;
+  chunk->runs[page + npages - 1] = run;
+  bin_insert(run);
+}
+
+static t_chunk *new_chunk(void)
+{
+  char    *raw;
+  char    *aligned;
+  size_t  front;
+  t_chunk *chunk;
+  t_slab  *run;
+
+  if (!(run = desc_new()))
+    return (NULL);
+  // Over-map then trim so the chunk is aligned to its own size
+  raw = heap_mmap(MEDIUM_CHUNK_SIZE * 2);
+  if (raw == MAP_FAILED)
+    {
+      desc_free(run);
+      return (NULL);
+    }
+  aligned = (char *)(((uintptr_t)raw + MEDIUM_CHUNK_SIZE - 1)
+                     & ~((uintptr_t)MEDIUM_CHUNK_SIZE - 1));
+  front = aligned - raw;
+  if (front)
+    heap_munmap(raw, front);
+  heap_munmap(aligned + MEDIUM_CHUNK_SIZE, MEDIUM_CHUNK_SIZE - front);
+  stat_add(&g_stats.medium_chunks, 1);
+
+  chunk = (t_chunk *)aligned;
+  chunk->free_pages = MEDIUM_CHUNK_PAGES - MEDIUM_FIRST_PAGE;
+  chunk->fresh = MEDIUM_FIRST_PAGE;
+  chunk->stamp = now_ms();
+  chunk->prev = NULL;
+  chunk->next = g_heap.medium;
+  if (g_heap.medium)
+    g_heap.medium->prev = chunk;
+  g_heap.medium = chunk;
+  set_free_run(chunk, run, MEDIUM_FIRST_PAGE, chunk->free_pages);
+  g_heap.medium_empty++;
+  return (chunk);
+}
+
+// Smallest free run with at least npages pages
+static t_slab *find_run(size_t npages)
+{
+  size_t  idx;
+  size_t  word;
+  uint64_t bits;
+  t_slab  *run;
+  t_slab  *best;
+
+  idx = bin_index(npages);
+  word = idx / 64;
+  bits = g_heap.medium_bins[word] & (~0ULL << (idx % 64));
+  while (!bits && ++word < (MEDIUM_BINS + 63) / 64)
+    bits = g_heap.medium_bins[word];
+  if (!bits)
+    return (NULL);
+  idx = word * 64 + __builtin_ctzll(bits);
+  if (idx < MEDIUM_BINS - 1)
+    return (g_heap.medium_free[idx]);
+  // Last bin holds mixed lengths: best fit
+  best = NULL;
+  for (run = g_heap.medium_free[idx]; run; run = run->next)
+    if (run->total_blocks >= npages
+        && (!best || run->total_blocks < best->total_blocks))
+      best = run;
+  return (best);
+}
+
+/*
+** dirty (if not NULL): how many leading bytes of the run may hold old
+** data. Runs are carved from the front of free runs, so past the chunk's
+** high-water mark pages are still untouched zero pages.
+*/
+void *allocate_medium(size_t size, size_t *dirty)
+{
+  size_t  npages;
+  t_slab  *run;
+  t_slab  *tail;
+  t_chunk *chunk;
+  size_t  page;
+  size_t  len;
+
+  npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+  if (!(run = find_run(npages)))
+    {
+      if (!new_chunk())
+        return (NULL);
+      run = find_run(npages);
+    }
+  chunk = run->chunk;
+  page = run->data_offset;
+  len = run->total_blocks;
+  // the tail goes back to the bins under a descriptor of its own
+  tail = NULL;
+  if (len > npages && !(tail = desc_new()))
+    return (NULL);
+  if (!pagemap_set(medium_run_addr(run), PAGE_SIZE, run))
+    {
+      if (tail)
+        desc_free(tail);
+      return (NULL);
+    }
+  if (chunk->free_pages == MEDIUM_CHUNK_PAGES - MEDIUM_FIRST_PAGE)
+    g_heap.medium_empty--;
+
+  bin_remove(run);
+  if (tail)
+    set_free_run(chunk, tail, page + npages, len - npages);
+  run->total_blocks = npages;
+  run->free_count = 0;
+  run->block_size = size;
+  chunk->runs[page + npages - 1] = run;
+  chunk->free_pages -= npages;
+  stat_add(&g_stats.medium_nmalloc, 1);
+  stat_add(&g_stats.medium_bytes, npages * PAGE_SIZE);
+  if (dirty)
+    *dirty = (chunk->fresh > page) ? (chunk->fresh - page) * PAGE_SIZE : 0;
+  if (chunk->fresh < page + npages)
+    chunk->fresh = page + npages;
+  return (medium_run_addr(run));
+}
+
+static void release_chunk(t_chunk *chunk)
+{
+  t_slab *run;
+
+  run = chunk->runs[MEDIUM_FIRST_PAGE];
+  bin_remove(run);
+  desc_free(run);
+  if (chunk->prev)
+    chunk->prev->next = chunk->next;
+  else
+    g_heap.medium = chunk->next;
+  if (chunk->next)
+    chunk->next->prev = chunk->prev;
+  stat_add(&g_stats.medium_chunks, -1);
+  heap_munmap(chunk, MEDIUM_CHUNK_SIZE);
+}
+
+void free_medium(t_slab *run)
+{
+  t_chunk *chunk;
+  size_t  page;
+  size_t  npages;
+  t_slab  *next;
+  t_slab  *prev;
+
+  chunk = run->chunk;
+  page = run->data_offset;
+  npages = run->total_blocks;
+  pagemap_set(medium_run_addr(run), PAGE_SIZE, NULL);
+  chunk->free_pages += npages;
+  stat_add(&g_stats.medium_nfree, 1);
+  stat_add(&g_stats.medium_bytes, -(int64_t)npages * PAGE_SIZE);
+
+  // Coalesce forward: the run right after us, through its head tag
+  if (page + npages < MEDIUM_CHUNK_PAGES)
+    {
+      next = chunk->runs[page + npages];
+      if (next->free_count == 1)
+        {
+          bin_remove(next);
+          npages += next->total_blocks;
+          desc_free(next);
+        }
+    }
+  // Coalesce backward: the run right before us, through its tail tag
+  if (page > MEDIUM_FIRST_PAGE)
+    {
+      prev = chunk->runs[page - 1];
+      if (prev->free_count == 1)
+        {
+          bin_remove(prev);
+          page -= prev->total_blocks;
+          npages += prev->total_blocks;
+          desc_free(run);
+          run = prev;
+        }
+    }
+  set_free_run(chunk, run, page, npages);
+
+  // past medium_keep it waits for medium_decay, not munmap right away
+  if (chunk->free_pages == MEDIUM_CHUNK_PAGES - MEDIUM_FIRST_PAGE)
+    {
+      chunk->stamp = now_ms();
+      g_heap.medium_empty++;
+    }
+}
+
+/*
+** Every run an explicit heap still holds goes free (sea_heap_destroy):
+** one walk of the chunks, a trace event per run as if freed one by one.
+*/
+void medium_release_heap(uint32_t heap_id)
+{
+  t_chunk *chunk;
+  t_slab  *run;
+  size_t  page;
+  size_t  next;
+
+  for (chunk = g_heap.medium; chunk; chunk = chunk->next)
+    for (page = MEDIUM_FIRST_PAGE; page < MEDIUM_CHUNK_PAGES; page = next)
+      {
+        run = chunk->runs[page];
+        next = page + run->total_blocks;
+        if (run->free_count != 0 || run->heap_id != heap_id)
+          continue;
+        if (__atomic_load_n(&g_trace.on, __ATOMIC_RELAXED))
+          trace_record(TRACE_FREE, medium_run_addr(run), 0, 0, 0);
+        free_medium(run);
+        // re-read the run covering page, never the descriptor just freed:
+        // the one before if it took ours in (its old tail tag names it),
+        // else ours, merged forward or not
+        run = page > MEDIUM_FIRST_PAGE ? chunk->runs[page - 1] : NULL;
+        if (!run || run->data_offset + run->total_blocks <= page)
+          run = chunk->runs[page];
+        next = run->data_offset + run->total_blocks;
+      }
+}
+
+/*
+** Fully free chunks past medium_keep that sat idle for decay_ms go back
+** to the kernel; forced, every fully free chunk does. Called from
+** slab_decay under g_medium_lock.
+*/
+void medium_decay(uint32_t now, bool force)
+{
+  t_chunk   *chunk;
+  t_chunk   *next;
+  uint32_t  decay;
+  size_t    keep;
+
+  decay = (uint32_t)__atomic_load_n(&g_conf.decay_ms, __ATOMIC_RELAXED);
+  keep = force ? 0 : __atomic_load_n(&g_conf.medium_keep, __ATOMIC_RELAXED);
+  for (chunk = g_heap.medium; chunk && g_heap.medium_empty > keep;
+       chunk = next)
+    {
+      next = chunk->next;
+      if (chunk->free_pages != MEDIUM_CHUNK_PAGES - MEDIUM_FIRST_PAGE
+          || (!force && now - chunk->stamp < decay))
+        continue;
+      g_heap.medium_empty--;
+      release_chunk(chunk);
+    }
+}
+
+/*
+** Free runs touched before (below the high-water mark) back to the
+** kernel, once per run: they fault back in as zero pages, so a run that
+** reaches the mark takes it back down. With release, fully free chunks
+** are unmapped too. Returns the bytes handed back.
+*/
+size_t medium_purge(bool release)
+{
+  t_chunk *chunk;
+  t_chunk *next;
+  t_slab  *run;
+  size_t  page;
+  size_t  end;
+  size_t  released;
+
+  released = 0;
+  for (chunk = g_heap.medium; chunk; chunk = next)
+    {
+      next = chunk->next;
+      if (release && chunk->free_pages == MEDIUM_CHUNK_PAGES - MEDIUM_FIRST_PAGE)
+        {
+          g_heap.medium_empty--;
+          release_chunk(chunk);
+          released += MEDIUM_CHUNK_SIZE;
+          continue;
+        }
+      for (page = MEDIUM_FIRST_PAGE; page < chunk->fresh; page = end)
+        {
+          run = chunk->runs[page];
+          end = page + run->total_blocks;
+          if (run->free_count != 1 || run->advised)
+            continue;
+          if (end >= chunk->fresh)
+            end = chunk->fresh;
+          if (madvise(medium_run_addr(run), (end - page) * PAGE_SIZE,
+                      MADV_DONTNEED) != 0)
+            continue;
+          released += (end - page) * PAGE_SIZE;
+          run->advised = 1;
+          if (end == chunk->fresh)
+            chunk->fresh = page;
+        }
+    }
+  return (released);
+}
@@ -0,0 +1,101 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: pagemap.c                                                   */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 17:41:11 by espadara                              */
+/*      Updated: 2026/10/17 19:02:57 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+
+/*
+** Root of the radix tree. 2^18 pointers = 2 MB of .bss that is never
+** touched except for the slots covering addresses we actually mapped.
+** Nothing here takes a lock: writers under different tier locks only ever
+** touch the slots of their own mappings, a new leaf is installed with a
+** CAS, and readers (the free fast path) use atomic loads.
+*/
+static t_slab **g_pagemap[1UL << PAGEMAP_ROOT_BITS];
+
+static t_slab **get_leaf(uintptr_t page, bool create)
+{
+  t_slab **leaf;
+  t_slab **expected;
+  size_t leaf_size;
+
+  leaf = __atomic_load_n(&g_pagemap[page >> PAGEMAP_LEAF_BITS], __ATOMIC_ACQUIRE);
+  if (leaf || !create)
+    return (leaf);
+  leaf_size = sizeof(t_slab *) << PAGEMAP_LEAF_BITS;
+  leaf = heap_mmap(leaf_size);
+  if (leaf == MAP_FAILED)
+    return (NULL);
+  expected = NULL;
+  if (!__atomic_compare_exchange_n(&g_pagemap[page >> PAGEMAP_LEAF_BITS],
+                                   &expected, leaf, false, __ATOMIC_ACQ_REL,
+                                   __ATOMIC_ACQUIRE))
+    {
+      // another tier installed this leaf first: use theirs
+      heap_munmap(leaf, leaf_size);
+      return (expected);
+    }
+  return (leaf);
+}
+
+// Map every page of [start, start + len) to slab (NULL to unregister)
+bool pagemap_set(void *start, size_t len, t_slab *slab)
+{
+  uintptr_t page;
+  uintptr_t end;
+  t_slab **leaf;
+
+  page = (uintptr_t)start >> PAGE_SHIFT;
+  end = ((uintptr_t)start + len + PAGE_SIZE - 1) >> PAGE_SHIFT;
+  if (end > (1UL << (PAGEMAP_ROOT_BITS + PAGEMAP_LEAF_BITS)))
+    return (false);
+  while (page < end)
+    {
+      if (!(leaf = get_leaf(page, slab != NULL)))
+        {
+          if (slab)
+            return (false);
+          // nothing was ever registered in this gigabyte
+          page = (page | ((1UL << PAGEMAP_LEAF_BITS) - 1)) + 1;
+          continue;
+        }
+      __atomic_store_n(&leaf[page & ((1UL << PAGEMAP_LEAF_BITS) - 1)],
+                       slab, __ATOMIC_RELEASE);
+      page++;
+    }
+  return (true);
+}
+
+t_slab *pagemap_get(const void *ptr)
+{
+  uintptr_t page;
+  t_slab **leaf;
+
+  page = (uintptr_t)ptr >> PAGE_SHIFT;
+  if (page >> (PAGEMAP_ROOT_BITS + PAGEMAP_LEAF_BITS))
+    return (NULL);
+  if (!(leaf = get_leaf(page, false)))
+    return (NULL);
+  return (__atomic_load_n(&leaf[page & ((1UL << PAGEMAP_LEAF_BITS) - 1)],
+                          __ATOMIC_ACQUIRE));
+}
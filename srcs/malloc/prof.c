@@ -0,0 +1,483 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: prof.c                                                      */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 19:05:23 by espadara                              */
+/*      Updated: 2026/10/17 20:42:41 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+#include <execinfo.h>
+
+t_prof g_prof = {.lock = PTHREAD_MUTEX_INITIALIZER};
+__thread t_prof_thread g_prof_thread __attribute__((tls_model("initial-exec")));
+
+/*
+** -ln(u), u in (0, 1]: exponent straight from the double's bits, then
+** ln(m) = 2 atanh((m - 1) / (m + 1)) for the mantissa m in [1, 2),
+** four terms (|s| <= 1/3, error ~1e-5). No libm in the allocator.
+*/
+static double neg_log(double u)
+{
+  uint64_t  bits;
+  int       exp;
+  double    m;
+  double    s;
+  double    s2;
+
+  sea_memcpy(&bits, &u, sizeof(bits));
+  exp = (int)((bits >> 52) & 0x7FF) - 1023;
+  bits = (bits & ((1ULL << 52) - 1)) | (1023ULL << 52);
+  sea_memcpy(&m, &bits, sizeof(m));
+  s = (m - 1.0) / (m + 1.0);
+  s2 = s * s;
+  return (-(exp * 0.6931471805599453
+            + 2.0 * s * (1.0 + s2 * (1.0 / 3 + s2 * (1.0 / 5 + s2 / 7)))));
+}
+
+// Exponential with mean rate: sampling stays memoryless (Poisson)
+static int64_t prof_interval(t_prof_thread *pt, size_t rate)
+{
+  double u;
+
+  // xorshift64*
+  pt->rng ^= pt->rng >> 12;
+  pt->rng ^= pt->rng << 25;
+  pt->rng ^= pt->rng >> 27;
+  u = (double)((pt->rng * 2685821657736338717ULL) >> 11) + 1.0;
+  u *= 1.0 / 9007199254740992.0;
+  return ((int64_t)(neg_log(u) * (double)rate) + 1);
+}
+
+static uint64_t prof_hash(void **frames, int depth)
+{
+  uint64_t  hash;
+  int       i;
+
+  hash = 14695981039346656037ULL;
+  for (i = 0; i < depth; i++)
+    hash = (hash ^ (uint64_t)(uintptr_t)frames[i]) * 1099511628211ULL;
+  return (hash ? hash : 1);
+}
+
+static inline uint32_t ptr_slot(void *ptr)
+{
+  return ((uint32_t)(((uintptr_t)ptr >> 4) * 0x9E3779B97F4A7C15ULL >> 40)
+          & (PROF_SAMPLES - 1));
+}
+
+// Intern a stack (caller holds g_prof.lock). -1 once the table is full.
+static int stack_intern(void **frames, int depth)
+{
+  uint64_t      hash;
+  uint32_t      i;
+  t_prof_stack  *st;
+
+  hash = prof_hash(frames, depth);
+  i = hash & (PROF_STACKS - 1);
+  while ((st = &g_prof.stacks[i])->hash)
+    {
+      if (st->hash == hash && st->depth == (uint32_t)depth
+          && !sea_memcmp(st->frames, frames, depth * sizeof(void *)))
+        return (i);
+      i = (i + 1) & (PROF_STACKS - 1);
+    }
+  if (g_prof.nstacks >= PROF_STACKS / 4 * 3)
+    return (-1);
+  st->hash = hash;
+  st->depth = depth;
+  sea_memcpy(st->frames, frames, depth * sizeof(void *));
+  g_prof.nstacks++;
+  return (i);
+}
+
+// Linear probing, deletion by backward shift: no tombstones to pile up
+static t_prof_sample *sample_find(void *ptr)
+{
+  uint32_t i;
+
+  i = ptr_slot(ptr);
+  while (g_prof.samples[i].ptr)
+    {
+      if (g_prof.samples[i].ptr == ptr)
+        return (&g_prof.samples[i]);
+      i = (i + 1) & (PROF_SAMPLES - 1);
+    }
+  return (NULL);
+}
+
+static void sample_remove(t_prof_sample *hole)
+{
+  uint32_t  i;
+  uint32_t  j;
+  uint32_t  home;
+
+  i = hole - g_prof.samples;
+  j = i;
+  while (1)
+    {
+      j = (j + 1) & (PROF_SAMPLES - 1);
+      if (!g_prof.samples[j].ptr)
+        break;
+      home = ptr_slot(g_prof.samples[j].ptr);
+      // j may fill the hole only if its home isn't cyclically in (i, j]
+      if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j))
+        {
+          g_prof.samples[i] = g_prof.samples[j];
+          i = j;
+        }
+    }
+  g_prof.samples[i].ptr = NULL;
+  __atomic_store_n(&g_prof.nsamples, g_prof.nsamples - 1, __ATOMIC_RELAXED);
+}
+
+// A slab block's key: its offset from the header, in 16 byte units
+static inline uint64_t slab_key(t_slab *slab, void *ptr)
+{
+  return (((uintptr_t)ptr - (uintptr_t)slab) / MIN_ALIGNMENT);
+}
+
+static int lane_of(uint64_t at, uint64_t key)
+{
+  int lane;
+
+  for (lane = 0; lane < 4; lane++)
+    if (((at >> (lane * 16)) & 0xFFFF) == key)
+      return (lane);
+  return (-1);
+}
+
+// Note (or forget) a sample in its header (caller holds g_prof.lock)
+static void mark_sampled(t_slab *slab, void *ptr, bool on)
+{
+  uint64_t  at;
+  uint64_t  key;
+  int       lane;
+
+  // keys past 16 bits (blocks beyond the first MB) only go in the count
+  if (slab->type < 2 && (key = slab_key(slab, ptr)) <= 0xFFFF)
+    {
+      at = slab->sampled_at;
+      if ((lane = lane_of(at, on ? 0 : key)) >= 0)
+        {
+          at &= ~(0xFFFFULL << (lane * 16));
+          if (on)
+            at |= key << (lane * 16);
+          __atomic_store_n(&slab->sampled_at, at, __ATOMIC_RELAXED);
+          return;
+        }
+    }
+  __atomic_store_n(&slab->sampled_more, slab->sampled_more + (on ? 1 : -1),
+                   __ATOMIC_RELAXED);
+}
+
+static void prof_record(void *ptr, size_t size, void **frames, int depth)
+{
+  int           stack;
+  uint32_t      i;
+  t_prof_stack  *st;
+
+  pthread_mutex_lock(&g_prof.lock);
+  if (g_prof.nsamples < PROF_SAMPLES / 4 * 3
+      && (stack = stack_intern(frames, depth)) >= 0)
+    {
+      i = ptr_slot(ptr);
+      while (g_prof.samples[i].ptr)
+        i = (i + 1) & (PROF_SAMPLES - 1);
+      g_prof.samples[i].ptr = ptr;
+      g_prof.samples[i].size = size;
+      g_prof.samples[i].stack = stack;
+      __atomic_store_n(&g_prof.nsamples, g_prof.nsamples + 1,
+                       __ATOMIC_RELAXED);
+      st = &g_prof.stacks[stack];
+      st->live_count++;
+      st->live_bytes += size;
+      st->total_count++;
+      st->total_bytes += size;
+      mark_sampled(pagemap_get(ptr), ptr, true);
+    }
+  pthread_mutex_unlock(&g_prof.lock);
+}
+
+/*
+** The countdown went below zero: draw the next interval, and sample ptr
+** unless profiling is off, the countdown was never armed, or we got here
+** from inside the profiler.
+*/
+__attribute__((noinline))
+void prof_sample(void *ptr, size_t size)
+{
+  t_prof_thread *pt;
+  size_t        rate;
+  bool          armed;
+  void          *frames[PROF_DEPTH + PROF_SKIP];
+  int           depth;
+
+  pt = &g_prof_thread;
+  // acquire: a rate is only published once the tables are mapped
+  rate = __atomic_load_n(&g_prof.rate, __ATOMIC_ACQUIRE);
+  if (!rate)
+    {
+      pt->left = PROF_IDLE_BYTES;
+      return;
+    }
+  armed = (pt->rng != 0);
+  if (!armed)
+    pt->rng = ((uintptr_t)pt ^ ((uint64_t)now_ms() << 32)) | 1;
+  pt->left = prof_interval(pt, rate);
+  if (!armed || !ptr || pt->busy)
+    return;
+  pt->busy = 1;
+  depth = backtrace(frames, PROF_DEPTH + PROF_SKIP) - PROF_SKIP;
+  if (depth > 0)
+    prof_record(ptr, size, frames + PROF_SKIP, depth);
+  pt->busy = 0;
+}
+
+// Drop ptr's sample, if it has one
+static void prof_drop(t_slab *slab, void *ptr)
+{
+  t_prof_sample *sample;
+  t_prof_stack  *st;
+
+  pthread_mutex_lock(&g_prof.lock);
+  if ((sample = sample_find(ptr)))
+    {
+      st = &g_prof.stacks[sample->stack];
+      st->live_count--;
+      st->live_bytes -= sample->size;
+      sample_remove(sample);
+      mark_sampled(slab, ptr, false);
+    }
+  pthread_mutex_unlock(&g_prof.lock);
+}
+
+/*
+** The header has samples: a slab block only needs the table if it is in
+** one of the lanes or some samples didn't fit in them.
+*/
+void prof_check(t_slab *slab, void *ptr)
+{
+  if (slab->type < 2
+      && !__atomic_load_n(&slab->sampled_more, __ATOMIC_RELAXED)
+      && lane_of(__atomic_load_n(&slab->sampled_at, __ATOMIC_RELAXED),
+                 slab_key(slab, ptr)) < 0)
+    return;
+  prof_drop(slab, ptr);
+}
+
+/*
+** Start sampling about every sample_bytes allocated bytes (0: the
+** default). Tables are mapped on first start and kept; other threads
+** pick the rate up within PROF_IDLE_BYTES of allocation.
+*/
+__attribute__((visibility("default")))
+void sea_malloc_prof_start(size_t sample_bytes)
+{
+  void *frames[1];
+  void *stacks;
+  void *samples;
+
+  pthread_mutex_lock(&g_prof.lock);
+  if (!g_prof.samples)
+    {
+      stacks = heap_mmap(PROF_STACKS * sizeof(t_prof_stack));
+      samples = heap_mmap(PROF_SAMPLES * sizeof(t_prof_sample));
+      if (stacks == MAP_FAILED || samples == MAP_FAILED)
+        {
+          if (stacks != MAP_FAILED)
+            heap_munmap(stacks, PROF_STACKS * sizeof(t_prof_stack));
+          if (samples != MAP_FAILED)
+            heap_munmap(samples, PROF_SAMPLES * sizeof(t_prof_sample));
+          pthread_mutex_unlock(&g_prof.lock);
+          return;
+        }
+      g_prof.stacks = stacks;
+      g_prof.samples = samples;
+    }
+  g_prof.period = sample_bytes ? sample_bytes : PROF_DEFAULT_RATE;
+  pthread_mutex_unlock(&g_prof.lock);
+  // the first backtrace() loads the unwinder, which allocates
+  g_prof_thread.busy = 1;
+  backtrace(frames, 1);
+  g_prof_thread.busy = 0;
+  __atomic_store_n(&g_prof.rate, sample_bytes ? sample_bytes
+                   : PROF_DEFAULT_RATE, __ATOMIC_RELEASE);
+  g_prof_thread.left = 0;
+}
+
+// No new samples; live ones are still dropped as they are freed
+__attribute__((visibility("default")))
+void sea_malloc_prof_stop(void)
+{
+  __atomic_store_n(&g_prof.rate, 0, __ATOMIC_RELAXED);
+}
+
+void prof_fork_prepare(void)
+{
+  pthread_mutex_lock(&g_prof.lock);
+}
+
+void prof_fork_parent(void)
+{
+  pthread_mutex_unlock(&g_prof.lock);
+}
+
+void prof_fork_child(void)
+{
+  pthread_mutex_init(&g_prof.lock, NULL);
+}
+
+/*
+** ---------- DUMP ----------
+** gperftools' heap profile (what pprof reads as a legacy heap profile):
+**   heap profile: <live>: <live bytes> [<total>: <total bytes>] @ heap_v2/<rate>
+**   <live>: <live bytes> [<total>: <total bytes>] @ 0x... 0x...   (per stack)
+**   MAPPED_LIBRARIES:
+**   <contents of /proc/self/maps>
+** Counts are raw samples; pprof un-samples them with the rate.
+*/
+typedef struct s_prof_out
+{
+  int     fd;
+  bool    ok;
+  size_t  len;
+  char    buf[4096];
+}	t_prof_out;
+
+static void out_flush(t_prof_out *out)
+{
+  size_t  done;
+  ssize_t n;
+
+  done = 0;
+  while (out->ok && done < out->len)
+    {
+      n = write(out->fd, out->buf + done, out->len - done);
+      if (n <= 0)
+        out->ok = false;
+      else
+        done += n;
+    }
+  out->len = 0;
+}
+
+static void out_str(t_prof_out *out, const char *str, size_t len)
+{
+  while (len--)
+    {
+      if (out->len == sizeof(out->buf))
+        out_flush(out);
+      out->buf[out->len++] = *str++;
+    }
+}
+
+static void out_num(t_prof_out *out, uint64_t n, int base)
+{
+  char  digits[24];
+  int   i;
+
+  i = sizeof(digits);
+  do
+    digits[--i] = "0123456789abcdef"[n % base];
+  while (n /= base);
+  if (base == 16)
+    out_str(out, "0x", 2);
+  out_str(out, digits + i, sizeof(digits) - i);
+}
+
+static void out_counts(t_prof_out *out, uint64_t live, uint64_t live_bytes,
+                       uint64_t total, uint64_t total_bytes)
+{
+  out_num(out, live, 10);
+  out_str(out, ": ", 2);
+  out_num(out, live_bytes, 10);
+  out_str(out, " [", 2);
+  out_num(out, total, 10);
+  out_str(out, ": ", 2);
+  out_num(out, total_bytes, 10);
+  out_str(out, "] @", 3);
+}
+
+static void out_maps(t_prof_out *out)
+{
+  int     fd;
+  ssize_t n;
+
+  out_str(out, "\nMAPPED_LIBRARIES:\n", 19);
+  out_flush(out);
+  if ((fd = open("/proc/self/maps", O_RDONLY)) < 0)
+    return;
+  while ((n = read(fd, out->buf, sizeof(out->buf))) > 0)
+    {
+      out->len = n;
+      out_flush(out);
+    }
+  close(fd);
+}
+
+/*
+** Write the profile to fd. Holds the profiler lock throughout, so
+** sampling (not allocation) waits for the dump. No memory is allocated.
+*/
+__attribute__((visibility("default")))
+bool sea_malloc_prof_dump(int fd)
+{
+  t_prof_out    out;
+  t_prof_stack  *st;
+  uint64_t      sums[4];
+  uint32_t      i;
+  uint32_t      f;
+
+  out.fd = fd;
+  out.ok = true;
+  out.len = 0;
+  sea_bzero(sums, sizeof(sums));
+  pthread_mutex_lock(&g_prof.lock);
+  for (i = 0; g_prof.stacks && i < PROF_STACKS; i++)
+    {
+      st = &g_prof.stacks[i];
+      sums[0] += st->live_count;
+      sums[1] += st->live_bytes;
+      sums[2] += st->total_count;
+      sums[3] += st->total_bytes;
+    }
+  out_str(&out, "heap profile: ", 14);
+  out_counts(&out, sums[0], sums[1], sums[2], sums[3]);
+  out_str(&out, " heap_v2/", 9);
+  out_num(&out, g_prof.period ? g_prof.period : PROF_DEFAULT_RATE, 10);
+  out_str(&out, "\n", 1);
+  for (i = 0; g_prof.stacks && i < PROF_STACKS; i++)
+    {
+      st = &g_prof.stacks[i];
+      if (!st->hash)
+        continue;
+      out_counts(&out, st->live_count, st->live_bytes, st->total_count,
+                 st->total_bytes);
+      for (f = 0; f < st->depth; f++)
+        {
+          out_str(&out, " ", 1);
+          out_num(&out, (uintptr_t)st->frames[f], 16);
+        }
+      out_str(&out, "\n", 1);
+    }
+  pthread_mutex_unlock(&g_prof.lock);
+  out_maps(&out);
+  return (out.ok);
+}
@@ -18,14 +18,91 @@
 /*      Filename: realloc.c                                                   */
 /*      By: espadara <espadara@pirate.capn.gg>                                */
 /*      Created: 2025/11/11 22:39:32 by espadara                              */
-/*      Updated: 2025/11/23 16:52:20 by espadara                              */
+/*      Updated: 2026/10/17 20:59:44 by espadara                              */
 /*                                                                            */
 /* ************************************************************************** */
 
+#define _GNU_SOURCE
 #include "sea_malloc.h"
 
-__attribute__((visibility("default")))
-void *sea_realloc(void *ptr, size_t size)
+/*
+** LARGE blocks never copy: page-rounded slack absorbs small growth,
+** mremap moves page tables (O(pages), not O(bytes)) for the rest, and a
+** shrink hands the tail pages straight back to the kernel.
+*/
+static void *realloc_large(t_slab *slab, size_t size)
+{
+  char            *base;
+  size_t          offset;
+  size_t          old_map;
+  size_t          new_map;
+  char            *moved;
+  pthread_mutex_t *lock;
+
+  // the header is not at the mapping start for aligned blocks
+  base = large_map_base(slab);
+  offset = (char *)slab - base;
+  if (size > SIZE_MAX - offset - sizeof(t_slab) - PAGE_SIZE)
+    return (NULL);
+  old_map = large_map_size(slab);
+  new_map = (offset + sizeof(t_slab) + size + PAGE_SIZE - 1)
+            & ~(PAGE_SIZE - 1);
+
+  // a moved header would carry a sample keyed by the old pointer
+  if (new_map > old_map)
+    prof_free(slab, slab + 1);
+  lock = slab_lock(slab);
+  pthread_mutex_lock(lock);
+  if (new_map < old_map)
+    heap_munmap(base + new_map, old_map - new_map);
+  else if (new_map > old_map)
+    {
+      moved = mremap(base, old_map, new_map, MREMAP_MAYMOVE);
+      if (moved == MAP_FAILED)
+        {
+          pthread_mutex_unlock(lock);
+          return (NULL);
+        }
+      // grown in place or moved, it's still the one mapping
+      stat_add(&g_stats.mapped, new_map - old_map);
+      if (moved != base)
+        {
+          // Same header, new address: fix the page map and the list links
+          pagemap_set(slab + 1, 1, NULL);
+          slab = (t_slab *)(moved + offset);
+          pagemap_set(slab + 1, 1, slab);
+          if (slab->prev)
+            slab->prev->next = slab;
+          else
+            slab_heap(slab)->large = slab;
+          if (slab->next)
+            slab->next->prev = slab;
+        }
+    }
+  slab->block_size = size;
+  stat_add(&g_stats.large_bytes, (int64_t)new_map - (int64_t)old_map);
+  pthread_mutex_unlock(lock);
+  return ((void *)(slab + 1));
+}
+
+/*
+** A block only stays put if sea_malloc(size) would have handed out the
+** same kind of block: same class for TINY/SMALL, same tier otherwise.
+** sea_free_sized() relies on it to find the class from the size alone.
+*/
+static bool same_home(t_slab *slab, int type, size_t size)
+{
+  if (type < 2)
+    return (size <= g_conf.small_max
+            && size_to_class(size) == slab->class_idx);
+  return (size_type(size) == type);
+}
+
+/*
+** sea_realloc, untraced. *stamp is the trace time of a call that
+** releases the old block: taken just before it goes (see t_trace_event).
+*/
+static void *realloc_block(void *ptr, size_t size, uint64_t *stamp)
 {
   t_slab  *slab;
   size_t  old_size;
@@ -33,32 +110,58 @@ void *sea_realloc(void *ptr, size_t size)
   int     type;
 
   if (!ptr)
-    return (sea_malloc(size));
+    return (malloc_block(size));
   if (size == 0)
     {
-      sea_free(ptr);
+      *stamp = trace_stamp();
+      free_block(ptr);
       return (NULL);
     }
-  pthread_mutex_lock(&g_malloc_mutex);
+  // page map lookup is lock-free
   slab = find_slab_by_ptr(ptr, &type);
   if (!slab)
+    return (NULL);
+  if (same_home(slab, type, size))
     {
-      pthread_mutex_unlock(&g_malloc_mutex);
-      return (NULL);
-    }
-  old_size = slab->block_size;
-  if (size <= old_size)
-    {
-      pthread_mutex_unlock(&g_malloc_mutex);
-      return (ptr);
+      if (type == 2)
+        return (realloc_large(slab, size));
+      if (size <= slab->block_size)
+        return (ptr);
+      // MEDIUM: the run is whole pages, use its slack first
+      if (type == 3 && size <= (size_t)slab->total_blocks * PAGE_SIZE)
+        {
+          pthread_mutex_lock(&g_medium_lock.mutex);
+          slab->block_size = size;
+          pthread_mutex_unlock(&g_medium_lock.mutex);
+          return (ptr);
+        }
     }
-  pthread_mutex_unlock(&g_malloc_mutex);
-  new_ptr = sea_malloc(size);
+  // all of the old block is usable (sea_malloc_usable_size), carry it over
+  old_size = sea_malloc_usable_size(ptr);
+  // a block moving out of an explicit heap stays in it
+  if (slab->heap_id)
+    new_ptr = heap_block(g_heaps.table[slab->heap_id], size);
+  else
+    new_ptr = malloc_block(size);
   if (!new_ptr)
     return (NULL);
-  sea_memcpy_fast(new_ptr, ptr, old_size);
-  sea_free(ptr);
+  sea_memcpy_fast(new_ptr, ptr, old_size < size ? old_size : size);
+  *stamp = trace_stamp();
+  free_block(ptr);
+
+  return (new_ptr);
+}
+
+__attribute__((visibility("default")))
+void *sea_realloc(void *ptr, size_t size)
+{
+  uint64_t  stamp;
+  void      *new_ptr;
 
+  stamp = 0;
+  new_ptr = realloc_block(ptr, size, &stamp);
+  if (__atomic_load_n(&g_trace.on, __ATOMIC_RELAXED))
+    trace_record(TRACE_REALLOC, new_ptr, (uintptr_t)ptr, size, stamp);
   return (new_ptr);
 }
 
@@ -75,15 +178,15 @@ void *sea_reallocf(void *ptr, size_t size)
 __attribute__((visibility("default")))
 void *sea_calloc(size_t count, size_t size)
 {
-  void *ptr;
-  size_t total;
+  size_t  total;
+  void    *ptr;
 
   total = count * size;
   if (count != 0 && total / count != size)
     return (NULL);
 
-  ptr = sea_malloc(total);
-  if (ptr)
-    sea_bzero(ptr, total);
+  // only what may hold old data gets cleared
+  ptr = malloc_zeroed(total);
+  trace_op(TRACE_CALLOC, ptr, 0, total);
   return (ptr);
 }
@@ -0,0 +1,103 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: remote.c                                                    */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 18:18:00 by espadara                              */
+/*      Updated: 2026/10/17 20:39:16 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "sea_malloc.h"
+
+/*
+** Remote frees: one MPSC list per TINY/SMALL class on the heap.
+** Any thread pushes with a single CAS (a whole tcache batch goes as one
+** pre-linked chain) and never touches a slab. Whoever holds the class
+** lock takes the whole list with one exchange, so there is no pop and
+** no ABA. Blocks on the list are still marked used in their slab.
+** Past REMOTE_APPLY pending blocks the pusher applies the list itself,
+** but only with a trylock: a free never waits on a class lock.
+*/
+void remote_free_push(int class_idx, void *first, void *last,
+                      uint32_t count)
+{
+  t_remote  *remote;
+  void      *head;
+
+  remote = &g_heap.remote[class_idx];
+  head = __atomic_load_n(&remote->head, __ATOMIC_RELAXED);
+  do
+    *(void **)last = head;
+  while (!__atomic_compare_exchange_n(&remote->head, &head, first,
+                                      true, __ATOMIC_RELEASE,
+                                      __ATOMIC_RELAXED));
+  if (__atomic_add_fetch(&remote->count, count, __ATOMIC_RELAXED)
+      < REMOTE_APPLY)
+    return;
+  if (pthread_mutex_trylock(&g_class_lock[class_idx].mutex))
+    return;
+  remote_free_take(class_idx, NULL, 0);
+  pthread_mutex_unlock(&g_class_lock[class_idx].mutex);
+}
+
+/*
+** Reclaim the class's remote list (caller holds its class lock).
+** The first count blocks go straight to out, still hot and already marked
+** used; the rest go back to their slab bitmaps.
+*/
+size_t remote_free_take(int class_idx, void **out, size_t count)
+{
+  t_remote  *remote;
+  void      *block;
+  void      *next;
+  size_t    n;
+  uint32_t  taken;
+
+  remote = &g_heap.remote[class_idx];
+  if (!__atomic_load_n(&remote->head, __ATOMIC_RELAXED))
+    return (0);
+  block = __atomic_exchange_n(&remote->head, NULL, __ATOMIC_ACQUIRE);
+  n = 0;
+  taken = 0;
+  while (block)
+    {
+      next = *(void **)block;
+      if (n < count)
+        out[n++] = block;
+      else
+        free_slab_block(pagemap_get(block), block);
+      block = next;
+      taken++;
+    }
+  __atomic_sub_fetch(&remote->count, taken, __ATOMIC_RELAXED);
+  return (n);
+}
+
+// Every class back into the bitmaps (caller holds no lock)
+void remote_free_reclaim_all(void)
+{
+  int i;
+
+  for (i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+      pthread_mutex_lock(&g_class_lock[i].mutex);
+      remote_free_take(i, NULL, 0);
+      pthread_mutex_unlock(&g_class_lock[i].mutex);
+    }
+}
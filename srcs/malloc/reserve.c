@@ -0,0 +1,156 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: reserve.c                                                   */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 20:12:19 by espadara                              */
+/*      Updated: 2026/10/17 20:12:19 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+
+// A written byte per page past the header: a read would map the zero page
+static void reserve_fault(t_slab *slab)
+{
+  volatile char *page;
+  char          *end;
+
+  end = (char *)slab + (size_t)slab->zone_pages * PAGE_SIZE;
+  for (page = (char *)slab + PAGE_SIZE; page < end; page += PAGE_SIZE)
+    *page = 0;
+}
+
+static void reserve_unpin(t_slab *slab)
+{
+  for (; slab; slab = slab->next)
+    slab->pinned = 0;
+}
+
+/*
+** The class's zones lose their pin. Free ones go the way of any empty
+** zone: retained up to slab_keep, the rest released.
+*/
+static void reserve_drop(int class_idx)
+{
+  t_slab *slab;
+
+  reserve_unpin(*class_list(class_idx, 0));
+  reserve_unpin(*class_list(class_idx, 1));
+  while ((slab = g_heap.reserve[class_idx]))
+    {
+      slab_unlink(&g_heap.reserve[class_idx], slab);
+      slab->pinned = 0;
+      if (g_heap.empty_count[class_idx]
+          < __atomic_load_n(&g_conf.slab_keep, __ATOMIC_RELAXED))
+        {
+          slab->stamp = now_ms();
+          slab->advised = 0;
+          slab_push(class_list(class_idx, 2), slab);
+          g_heap.empty_count[class_idx]++;
+        }
+      else
+        slab_release(slab);
+    }
+  g_heap.reserve_blocks[class_idx] = 0;
+}
+
+/*
+** Make sure count blocks of size's class sit in pinned zones, faulted
+** in: retained empty zones are taken first, then new ones mapped. Only
+** ever grows; count 0 drops the reservation. Returns the blocks now
+** reserved (short only if memory ran out), 0 past small_max.
+*/
+__attribute__((visibility("default")))
+size_t sea_malloc_reserve(size_t size, size_t count)
+{
+  int     class_idx;
+  t_slab  *slab;
+  size_t  reserved;
+
+  conf_boot();
+  if (size == 0 || size > g_conf.small_max)
+    return (0);
+  class_idx = size_to_class(size);
+  pthread_mutex_lock(&g_class_lock[class_idx].mutex);
+  if (!count)
+    reserve_drop(class_idx);
+  while (g_heap.reserve_blocks[class_idx] < count)
+    {
+      if ((slab = *class_list(class_idx, 2)))
+        {
+          slab_unlink(class_list(class_idx, 2), slab);
+          g_heap.empty_count[class_idx]--;
+        }
+      else if (!(slab = init_new_slab(size > TINY_BLOCK_MAX, class_idx,
+                                      class_to_size(class_idx))))
+        break;
+      slab->pinned = 1;
+      slab->advised = 0;
+      reserve_fault(slab);
+      slab_push(&g_heap.reserve[class_idx], slab);
+      g_heap.reserve_blocks[class_idx] += slab->total_blocks;
+    }
+  reserved = g_heap.reserve_blocks[class_idx];
+  pthread_mutex_unlock(&g_class_lock[class_idx].mutex);
+  return (reserved);
+}
+
+static void reserve_count(t_slab *slab, t_reserve_stats *out)
+{
+  unsigned char vec[THP_SIZE / PAGE_SIZE];
+  size_t        pages;
+  size_t        i;
+
+  for (; slab; slab = slab->next)
+    {
+      if (!slab->pinned)
+        continue;
+      pages = slab->zone_pages;
+      out->slabs++;
+      out->blocks += slab->total_blocks;
+      out->free += slab->free_count;
+      out->mapped += pages * PAGE_SIZE;
+      if (pages > sizeof(vec) || mincore(slab, pages * PAGE_SIZE, vec) != 0)
+        continue;
+      for (i = 0; i < pages; i++)
+        out->resident += (size_t)(vec[i] & 1) * PAGE_SIZE;
+    }
+}
+
+/*
+** The reservation of size's class as it stands: intact while free equals
+** blocks and resident equals mapped. Walks the class's zones under its
+** lock (remote frees applied first), so not for a hot loop.
+*/
+__attribute__((visibility("default")))
+bool sea_malloc_reserve_stats(size_t size, t_reserve_stats *out)
+{
+  int class_idx;
+
+  if (!out || size == 0 || size > g_conf.small_max)
+    return (false);
+  sea_bzero(out, sizeof(*out));
+  class_idx = size_to_class(size);
+  pthread_mutex_lock(&g_class_lock[class_idx].mutex);
+  remote_free_take(class_idx, NULL, 0);
+  reserve_count(*class_list(class_idx, 0), out);
+  reserve_count(*class_list(class_idx, 1), out);
+  reserve_count(g_heap.reserve[class_idx], out);
+  pthread_mutex_unlock(&g_class_lock[class_idx].mutex);
+  return (true);
+}
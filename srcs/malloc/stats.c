@@ -0,0 +1,212 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: stats.c                                                     */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 18:56:25 by espadara                              */
+/*      Updated: 2026/10/17 21:16:24 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+
+t_stats g_stats = {0};
+__thread t_thread_stats g_thread_stats __attribute__((tls_model("initial-exec")));
+
+// Live threads' counters. Only linking, unlinking and snapshots take it.
+static t_thread_stats   *g_stats_threads;
+static pthread_mutex_t  g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t    g_stats_key;
+static pthread_once_t   g_stats_once = PTHREAD_ONCE_INIT;
+
+// pthread key destructor: the counts outlive the thread in g_stats
+static void stats_thread_exit(void *arg)
+{
+  t_thread_stats  *ts = arg;
+  int             i;
+
+  pthread_mutex_lock(&g_stats_lock);
+  for (i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+      stat_add(&g_stats.nmalloc[i], ts->nmalloc[i]);
+      stat_add(&g_stats.nfree[i], ts->nfree[i]);
+    }
+  if (ts->prev)
+    ts->prev->next = ts->next;
+  else
+    g_stats_threads = ts->next;
+  if (ts->next)
+    ts->next->prev = ts->prev;
+  ts->state = 2;
+  pthread_mutex_unlock(&g_stats_lock);
+}
+
+static void stats_key_init(void)
+{
+  pthread_key_create(&g_stats_key, stats_thread_exit);
+}
+
+/*
+** First count of a thread links its counters; once it is exiting they
+** are gone, so what it still frees (other destructors) goes to g_stats.
+*/
+void stats_count_slow(int class_idx, uint64_t n, bool is_free)
+{
+  t_thread_stats *ts;
+
+  ts = &g_thread_stats;
+  if (ts->state == 0)
+    {
+      pthread_once(&g_stats_once, stats_key_init);
+      pthread_mutex_lock(&g_stats_lock);
+      ts->prev = NULL;
+      ts->next = g_stats_threads;
+      if (g_stats_threads)
+        g_stats_threads->prev = ts;
+      g_stats_threads = ts;
+      ts->state = 1;
+      pthread_mutex_unlock(&g_stats_lock);
+      // may allocate (and count) itself: the thread is live by now
+      pthread_setspecific(g_stats_key, ts);
+      stats_count(class_idx, n, is_free);
+      return;
+    }
+  stat_add(is_free ? &g_stats.nfree[class_idx] : &g_stats.nmalloc[class_idx],
+           n);
+}
+
+// Every mapping of the allocator goes through these two
+void *heap_mmap(size_t len)
+{
+  void *ptr;
+
+  ptr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr != MAP_FAILED)
+    {
+      stat_add(&g_stats.mmap_calls, 1);
+      stat_add(&g_stats.mapped, len);
+    }
+  return (ptr);
+}
+
+void heap_munmap(void *addr, size_t len)
+{
+  if (munmap(addr, len) == 0)
+    {
+      stat_add(&g_stats.munmap_calls, 1);
+      stat_add(&g_stats.mapped, -(int64_t)len);
+    }
+}
+
+void stats_fork_prepare(void)
+{
+  pthread_mutex_lock(&g_stats_lock);
+}
+
+void stats_fork_parent(void)
+{
+  pthread_mutex_unlock(&g_stats_lock);
+}
+
+void stats_fork_child(void)
+{
+  pthread_mutex_init(&g_stats_lock, NULL);
+}
+
+static inline uint64_t stat_get(uint64_t *counter)
+{
+  return (__atomic_load_n(counter, __ATOMIC_RELAXED));
+}
+
+// live, allocated and fragmentation from the counters already filled in
+static void stats_finish(t_alloc_stats *st, size_t unit)
+{
+  st->live = st->nmalloc > st->nfree ? st->nmalloc - st->nfree : 0;
+  if (unit)
+    st->allocated = st->live * unit;
+  st->fragmentation = 0.0;
+  if (st->mapped && st->allocated < st->mapped)
+    st->fragmentation = 1.0 - (double)st->allocated / (double)st->mapped;
+}
+
+/*
+** Snapshot, cheap enough to scrape every second: O(threads * classes)
+** counter reads, no heap lock held for more than reading two words.
+** Counters move while being read, so it is consistent per counter, not
+** across them (live is clamped at 0).
+*/
+__attribute__((visibility("default")))
+void sea_malloc_stats(t_malloc_stats *out)
+{
+  t_thread_stats  *ts;
+  t_alloc_stats   *st;
+  int             i;
+
+  if (!out)
+    return;
+  sea_bzero(out, sizeof(*out));
+  for (i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+      st = &out->classes[i];
+      st->block_size = class_to_size(i);
+      st->nmalloc = stat_get(&g_stats.nmalloc[i]);
+      st->nfree = stat_get(&g_stats.nfree[i]);
+      st->spans = stat_get(&g_stats.slabs[i]);
+      st->mapped = stat_get(&g_stats.zone_bytes[i]);
+    }
+  pthread_mutex_lock(&g_stats_lock);
+  for (ts = g_stats_threads; ts; ts = ts->next)
+    for (i = 0; i < NUM_SIZE_CLASSES; i++)
+      {
+        out->classes[i].nmalloc += stat_get(&ts->nmalloc[i]);
+        out->classes[i].nfree += stat_get(&ts->nfree[i]);
+      }
+  pthread_mutex_unlock(&g_stats_lock);
+  for (i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+      st = &out->classes[i];
+      stats_finish(st, st->block_size);
+      out->allocated += st->allocated;
+    }
+
+  out->medium.nmalloc = stat_get(&g_stats.medium_nmalloc);
+  out->medium.nfree = stat_get(&g_stats.medium_nfree);
+  out->medium.allocated = stat_get(&g_stats.medium_bytes);
+  out->medium.spans = stat_get(&g_stats.medium_chunks);
+  out->medium.mapped = out->medium.spans * MEDIUM_CHUNK_SIZE;
+  stats_finish(&out->medium, 0);
+
+  pthread_mutex_lock(&g_large_lock.mutex);
+  out->large_cached = g_heap.cache_bytes;
+  out->large_cached_count = g_heap.cache_count;
+  pthread_mutex_unlock(&g_large_lock.mutex);
+  out->large.nmalloc = stat_get(&g_stats.large_nmalloc);
+  out->large.nfree = stat_get(&g_stats.large_nfree);
+  out->large.allocated = stat_get(&g_stats.large_bytes);
+  out->large.mapped = out->large.allocated + out->large_cached;
+  stats_finish(&out->large, 0);
+  out->large.spans = out->large.live;
+
+  out->allocated += out->medium.allocated + out->large.allocated;
+  out->mmap_calls = stat_get(&g_stats.mmap_calls);
+  out->munmap_calls = stat_get(&g_stats.munmap_calls);
+  out->mapped = stat_get(&g_stats.mapped);
+  out->fragmentation = 0.0;
+  if (out->mapped && out->allocated < out->mapped)
+    out->fragmentation = 1.0 - (double)out->allocated / (double)out->mapped;
+}
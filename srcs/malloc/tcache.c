@@ -0,0 +1,171 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: tcache.c                                                    */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 17:41:20 by espadara                              */
+/*      Updated: 2026/10/17 21:10:17 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+
+/*
+** initial-exec: the TLS slot is resolved at load time, so reaching the
+** tcache never goes through __tls_get_addr (which may itself call malloc).
+*/
+static __thread t_tcache g_tcache __attribute__((tls_model("initial-exec")));
+
+static pthread_key_t  g_tcache_key;
+static pthread_once_t g_tcache_once = PTHREAD_ONCE_INIT;
+
+// Hand count blocks back as one chain: a single CAS, no lock
+static void tcache_drain(t_tcache_bin *bin, int class_idx, uint32_t count)
+{
+  void      *first;
+  void      *last;
+  uint32_t  before;
+
+  if (!count || !bin->head)
+    return;
+  before = bin->count;
+  first = bin->head;
+  last = first;
+  bin->count--;
+  while (--count && *(void **)last)
+    {
+      last = *(void **)last;
+      bin->count--;
+    }
+  bin->head = *(void **)last;
+  remote_free_push(class_idx, first, last, before - bin->count);
+}
+
+// pthread key destructor: give every cached block back to the slabs
+static void tcache_thread_exit(void *arg)
+{
+  t_tcache  *tc = arg;
+  int       i;
+
+  tc->state = 2;
+  for (i = 0; i < TCACHE_CLASSES; i++)
+    if (tc->bins[i].count)
+      tcache_drain(&tc->bins[i], i, tc->bins[i].count);
+}
+
+// This thread's cached blocks back to the slabs (sea_malloc_trim)
+void tcache_flush(void)
+{
+  int i;
+
+  if (g_tcache.state != 1)
+    return;
+  for (i = 0; i < TCACHE_CLASSES; i++)
+    if (g_tcache.bins[i].count)
+      tcache_drain(&g_tcache.bins[i], i, g_tcache.bins[i].count);
+}
+
+static void tcache_key_init(void)
+{
+  pthread_key_create(&g_tcache_key, tcache_thread_exit);
+}
+
+// tcache_max came down since this thread last looked: drop the bins past it
+static void tcache_clamp(t_tcache *tc, size_t classes)
+{
+  size_t i;
+
+  for (i = classes; i < tc->classes; i++)
+    if (tc->bins[i].count)
+      tcache_drain(&tc->bins[i], (int)i, tc->bins[i].count);
+  tc->classes = classes;
+}
+
+static inline t_tcache *tcache_get(void)
+{
+  size_t classes;
+
+  if (__builtin_expect(g_tcache.state != 1, 0))
+    {
+      if (g_tcache.state == 2)
+        return (NULL);
+      // live before setspecific: it may allocate and land back in here
+      g_tcache.state = 1;
+      pthread_once(&g_tcache_once, tcache_key_init);
+      pthread_setspecific(g_tcache_key, &g_tcache);
+    }
+  classes = __atomic_load_n(&g_conf.tcache_classes, __ATOMIC_RELAXED);
+  if (__builtin_expect(classes != g_tcache.classes, 0))
+    tcache_clamp(&g_tcache, classes);
+  return (&g_tcache);
+}
+
+void *tcache_alloc(size_t size)
+{
+  t_tcache      *tc;
+  t_tcache_bin  *bin;
+  void          *batch[TCACHE_BATCH_LIMIT];
+  size_t        n;
+  void          *block;
+
+  if (!(tc = tcache_get()))
+    return (NULL);
+  bin = &tc->bins[size_to_class(size)];
+  if (!bin->head)
+    {
+      pthread_mutex_lock(&g_class_lock[size_to_class(size)].mutex);
+      n = allocate_tiny_small_batch(size, batch, __atomic_load_n(
+                                      &g_conf.tcache_batch, __ATOMIC_RELAXED),
+                                    NULL);
+      pthread_mutex_unlock(&g_class_lock[size_to_class(size)].mutex);
+      slab_decay(false);
+      // keep address order: batch[0] ends up on top of the bin
+      while (n--)
+        {
+          *(void **)batch[n] = bin->head;
+          bin->head = batch[n];
+          bin->count++;
+        }
+      if (!bin->head)
+        return (NULL);
+    }
+  block = bin->head;
+  bin->head = *(void **)block;
+  bin->count--;
+  stats_count(size_to_class(size), 1, false);
+  return (block);
+}
+
+// Keyed by class only: sized frees get here without touching the header
+bool tcache_free(int class_idx, void *ptr)
+{
+  t_tcache      *tc;
+  t_tcache_bin  *bin;
+
+  if ((size_t)class_idx >= __atomic_load_n(&g_conf.tcache_classes,
+                                           __ATOMIC_RELAXED)
+      || !(tc = tcache_get()))
+    return (false);
+  bin = &tc->bins[class_idx];
+  if (bin->count >= __atomic_load_n(&g_conf.tcache_bin, __ATOMIC_RELAXED))
+    tcache_drain(bin, class_idx, __atomic_load_n(&g_conf.tcache_batch,
+                                                 __ATOMIC_RELAXED));
+  *(void **)ptr = bin->head;
+  bin->head = ptr;
+  bin->count++;
+  return (true);
+}
@@ -0,0 +1,120 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: thp.c                                                       */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 19:48:09 by espadara                              */
+/*      Updated: 2026/10/17 21:10:17 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "sea_malloc.h"
+
+t_thp g_thp = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+/*
+** len bytes (a page multiple) starting on a THP_SIZE boundary, advised
+** MADV_HUGEPAGE: over-map by THP_SIZE and trim both ends.
+*/
+static char *thp_map(size_t len)
+{
+  char    *raw;
+  char    *aligned;
+  size_t  front;
+
+  if (len > SIZE_MAX - THP_SIZE)
+    return (MAP_FAILED);
+  raw = heap_mmap(len + THP_SIZE);
+  if (raw == MAP_FAILED)
+    return (MAP_FAILED);
+  aligned = (char *)(((uintptr_t)raw + THP_SIZE - 1)
+                     & ~((uintptr_t)THP_SIZE - 1));
+  front = aligned - raw;
+  if (front)
+    heap_munmap(raw, front);
+  heap_munmap(aligned + len, THP_SIZE - front);
+  madvise(aligned, len, MADV_HUGEPAGE);
+  return (aligned);
+}
+
+/*
+** A TINY/SMALL zone of *len bytes, carved from the current region in THP
+** mode. A tail too short for another zone like this one goes with it
+** (*len grows): unmapping it would break the region's huge page.
+*/
+void *zone_mmap(size_t *len)
+{
+  char *zone;
+
+  if (!__atomic_load_n(&g_thp.on, __ATOMIC_RELAXED))
+    return (heap_mmap(*len));
+  pthread_mutex_lock(&g_thp.lock);
+  if ((size_t)(g_thp.end - g_thp.next) < *len)
+    {
+      if (g_thp.next != g_thp.end)
+        heap_munmap(g_thp.next, g_thp.end - g_thp.next);
+      g_thp.next = thp_map(THP_SIZE);
+      g_thp.end = g_thp.next + THP_SIZE;
+      if (g_thp.next == MAP_FAILED)
+        {
+          g_thp.next = NULL;
+          g_thp.end = NULL;
+          pthread_mutex_unlock(&g_thp.lock);
+          return (MAP_FAILED);
+        }
+    }
+  zone = g_thp.next;
+  if ((size_t)(g_thp.end - g_thp.next) < 2 * *len)
+    *len = g_thp.end - g_thp.next;
+  g_thp.next += *len;
+  pthread_mutex_unlock(&g_thp.lock);
+  return (zone);
+}
+
+// A new LARGE mapping: huge page aligned from THP_SIZE up in THP mode
+void *large_mmap(size_t len)
+{
+  if (len >= THP_SIZE && __atomic_load_n(&g_thp.on, __ATOMIC_RELAXED))
+    return (thp_map(len));
+  return (heap_mmap(len));
+}
+
+/*
+** Only changes where new zones and LARGE mappings come from: what is
+** mapped stays as it is.
+*/
+__attribute__((visibility("default")))
+void sea_malloc_thp(bool on)
+{
+  __atomic_store_n(&g_thp.on, on, __ATOMIC_RELAXED);
+}
+
+void thp_fork_prepare(void)
+{
+  pthread_mutex_lock(&g_thp.lock);
+}
+
+void thp_fork_parent(void)
+{
+  pthread_mutex_unlock(&g_thp.lock);
+}
+
+void thp_fork_child(void)
+{
+  pthread_mutex_init(&g_thp.lock, NULL);
+}
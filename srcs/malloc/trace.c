@@ -0,0 +1,311 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: trace.c                                                     */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 19:22:44 by espadara                              */
+/*      Updated: 2026/10/17 19:22:44 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "sea_malloc.h"
+#include <errno.h>
+#include <time.h>
+
+t_trace g_trace = {.fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+static __thread t_trace_ring *g_trace_ring
+    __attribute__((tls_model("initial-exec")));
+static __thread bool    g_trace_exited __attribute__((tls_model("initial-exec")));
+static pthread_key_t    g_trace_key;
+static pthread_once_t   g_trace_once = PTHREAD_ONCE_INIT;
+
+uint64_t trace_clock(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+/*
+** Append len bytes to the trace file (g_trace.lock held). A write that
+** fails ends the trace. free() must not clobber errno: it is kept.
+*/
+static void trace_write(const void *buf, size_t len)
+{
+  ssize_t n;
+  int     saved;
+
+  saved = errno;
+  while (g_trace.fd >= 0 && len)
+    {
+      n = write(g_trace.fd, buf, len);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        {
+          __atomic_store_n(&g_trace.on, 0, __ATOMIC_RELAXED);
+          close(g_trace.fd);
+          g_trace.fd = -1;
+          break;
+        }
+      buf = (const char *)buf + n;
+      len -= n;
+    }
+  errno = saved;
+}
+
+// Everything the owner published, at most two writes (g_trace.lock held)
+static void trace_drain(t_trace_ring *ring)
+{
+  uint64_t head;
+  uint64_t tail;
+  uint64_t end;
+
+  head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  tail = ring->tail;
+  while (tail != head)
+    {
+      end = tail - tail % TRACE_RING_EVENTS + TRACE_RING_EVENTS;
+      if (end > head)
+        end = head;
+      trace_write(&ring->events[tail % TRACE_RING_EVENTS],
+                  (end - tail) * sizeof(t_trace_event));
+      tail = end;
+    }
+  __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+}
+
+// pthread key destructor: write the ring out and give it up
+static void trace_thread_exit(void *arg)
+{
+  t_trace_ring *ring = arg;
+
+  pthread_mutex_lock(&g_trace.lock);
+  trace_drain(ring);
+  ring->owned = 0;
+  pthread_mutex_unlock(&g_trace.lock);
+  g_trace_ring = NULL;
+  g_trace_exited = true;
+}
+
+static void trace_key_init(void)
+{
+  pthread_key_create(&g_trace_key, trace_thread_exit);
+}
+
+// A ring some exited thread left behind, or a new one
+static t_trace_ring *trace_ring_get(void)
+{
+  t_trace_ring *ring;
+
+  pthread_once(&g_trace_once, trace_key_init);
+  pthread_mutex_lock(&g_trace.lock);
+  for (ring = g_trace.rings; ring && ring->owned; ring = ring->next)
+    ;
+  if (!ring)
+    {
+      ring = heap_mmap(sizeof(t_trace_ring));
+      if (ring == MAP_FAILED)
+        {
+          pthread_mutex_unlock(&g_trace.lock);
+          return (NULL);
+        }
+      ring->id = g_trace.nrings++;
+      ring->next = g_trace.rings;
+      g_trace.rings = ring;
+    }
+  ring->owned = 1;
+  pthread_mutex_unlock(&g_trace.lock);
+  g_trace_ring = ring;
+  pthread_setspecific(g_trace_key, ring);
+  return (ring);
+}
+
+static void trace_fill(t_trace_event *ev, uint32_t op, void *ptr,
+                       uintptr_t old, size_t size)
+{
+  ev->ptr = (uintptr_t)ptr;
+  ev->old = old;
+  ev->size = size;
+  ev->op = op;
+}
+
+/*
+** ns = 0: now. Lock-free unless the ring is full, then this thread
+** writes it out itself. A thread past its exit (other key destructors
+** still allocating) writes its events straight to the file.
+*/
+void trace_record(uint32_t op, void *ptr, uintptr_t old, size_t size,
+                  uint64_t ns)
+{
+  t_trace_ring  *ring;
+  t_trace_event *ev;
+  t_trace_event one;
+  uint64_t      head;
+
+  if (!ns)
+    ns = trace_clock();
+  ring = g_trace_ring;
+  if (__builtin_expect(!ring, 0)
+      && (g_trace_exited || !(ring = trace_ring_get())))
+    {
+      trace_fill(&one, op, ptr, old, size);
+      one.ns = ns;
+      one.thread = UINT32_MAX;
+      pthread_mutex_lock(&g_trace.lock);
+      trace_write(&one, sizeof(one));
+      pthread_mutex_unlock(&g_trace.lock);
+      return;
+    }
+  head = ring->head;
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)
+      == TRACE_RING_EVENTS)
+    {
+      pthread_mutex_lock(&g_trace.lock);
+      trace_drain(ring);
+      pthread_mutex_unlock(&g_trace.lock);
+    }
+  ev = &ring->events[head % TRACE_RING_EVENTS];
+  trace_fill(ev, op, ptr, old, size);
+  ev->ns = ns;
+  ev->thread = ring->id;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+** Start tracing to path (truncated). false if a trace is already being
+** written or the file can't be created.
+*/
+__attribute__((visibility("default")))
+bool sea_malloc_trace_start(const char *path)
+{
+  t_trace_header  hdr;
+  t_trace_ring    *ring;
+  bool            ok;
+
+  pthread_mutex_lock(&g_trace.lock);
+  if (g_trace.fd >= 0 || !path)
+    {
+      pthread_mutex_unlock(&g_trace.lock);
+      return (false);
+    }
+  g_trace.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  sea_bzero(&hdr, sizeof(hdr));
+  sea_memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+  hdr.version = TRACE_VERSION;
+  hdr.event_size = sizeof(t_trace_event);
+  trace_write(&hdr, sizeof(hdr));
+  // what an earlier trace left in the rings is not part of this one
+  for (ring = g_trace.rings; ring; ring = ring->next)
+    __atomic_store_n(&ring->tail, __atomic_load_n(&ring->head,
+                     __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+  ok = g_trace.fd >= 0;
+  __atomic_store_n(&g_trace.on, ok, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&g_trace.lock);
+  return (ok);
+}
+
+// Write out every ring and close the file
+__attribute__((visibility("default")))
+void sea_malloc_trace_stop(void)
+{
+  t_trace_ring *ring;
+
+  __atomic_store_n(&g_trace.on, 0, __ATOMIC_RELAXED);
+  pthread_mutex_lock(&g_trace.lock);
+  for (ring = g_trace.rings; ring; ring = ring->next)
+    trace_drain(ring);
+  if (g_trace.fd >= 0)
+    close(g_trace.fd);
+  g_trace.fd = -1;
+  pthread_mutex_unlock(&g_trace.lock);
+}
+
+void trace_fork_prepare(void)
+{
+  pthread_mutex_lock(&g_trace.lock);
+}
+
+void trace_fork_parent(void)
+{
+  pthread_mutex_unlock(&g_trace.lock);
+}
+
+/*
+** The child doesn't trace into its parent's file: it's closed. The rings
+** of the threads that didn't make it across are free to take.
+*/
+void trace_fork_child(void)
+{
+  t_trace_ring *ring;
+
+  pthread_mutex_init(&g_trace.lock, NULL);
+  __atomic_store_n(&g_trace.on, 0, __ATOMIC_RELAXED);
+  if (g_trace.fd >= 0)
+    close(g_trace.fd);
+  g_trace.fd = -1;
+  for (ring = g_trace.rings; ring; ring = ring->next)
+    if (ring != g_trace_ring)
+      ring->owned = 0;
+}
+
+/*
+** KRAKEN_MALLOC_TRACE=<file> traces from startup to exit. "%p" in the
+** name becomes the pid, so the processes of a preloaded pipeline don't
+** all truncate the same file.
+*/
+__attribute__((constructor))
+static void trace_env_start(void)
+{
+  char        path[PATH_MAX];
+  char        digits[16];
+  const char  *env;
+  size_t      len;
+  int         pid;
+  int         i;
+
+  if (!(env = getenv(TRACE_ENV)) || !*env)
+    return;
+  len = 0;
+  while (*env && len < sizeof(path) - sizeof(digits))
+    {
+      if (env[0] != '%' || env[1] != 'p')
+        {
+          path[len++] = *env++;
+          continue;
+        }
+      pid = getpid();
+      i = sizeof(digits);
+      do
+        digits[--i] = '0' + pid % 10;
+      while (pid /= 10);
+      while (i < (int)sizeof(digits))
+        path[len++] = digits[i++];
+      env += 2;
+    }
+  path[len] = '\0';
+  sea_malloc_trace_start(path);
+}
+
+__attribute__((destructor))
+static void trace_exit(void)
+{
+  if (__atomic_load_n(&g_trace.on, __ATOMIC_RELAXED))
+    sea_malloc_trace_stop();
+}
@@ -0,0 +1,416 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: trim.c                                                      */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 19:55:41 by espadara                              */
+/*      Updated: 2026/10/17 21:10:17 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "sea_malloc.h"
+#include <time.h>
+
+t_purge g_purge = {.lock = PTHREAD_MUTEX_INITIALIZER,
+                   .ctl = PTHREAD_MUTEX_INITIALIZER};
+
+/*
+** A zone's purgeable pages, gathered under its lock: mask holds their
+** blocks, marked used in the bitmap while the lock is dropped so nothing
+** is handed out of a page being madvise'd. [page, end) is the span that
+** was scanned.
+*/
+typedef struct s_purge_zone
+{
+  t_slab    *slab;
+  char      *page;
+  char      *end;
+  uint64_t  mask[SLAB_MAX_BLOCKS / 64];
+  uint32_t  words;
+  uint32_t  held;
+}	t_purge_zone;
+
+// Every block in [first, last] has its bit in map set (or clear)
+static bool blocks_are(const uint64_t *map, size_t first, size_t last,
+                       bool set)
+{
+  size_t    word;
+  uint64_t  mask;
+
+  for (word = first / 64; word <= last / 64; word++)
+    {
+      mask = ~0ULL;
+      if (word == first / 64)
+        mask &= ~0ULL << (first % 64);
+      if (word == last / 64 && last % 64 != 63)
+        mask &= ~(~0ULL << (last % 64 + 1));
+      if ((map[word] & mask) != (set ? mask : 0))
+        return (false);
+    }
+  return (true);
+}
+
+// The blocks a page of the zone overlaps, as [*first, *last]
+static void page_blocks(t_slab *slab, char *page, size_t *first,
+                        size_t *last)
+{
+  *first = (page - slab_data(slab)) / slab->block_size;
+  *last = (page + PAGE_SIZE - 1 - slab_data(slab)) / slab->block_size;
+  if (*last >= slab->total_blocks)
+    *last = slab->total_blocks - 1;
+}
+
+/*
+** Pages of a zone in use that hold no live block, from the bitmap: the
+** header page stays, and nothing past fresh was ever touched. Their
+** blocks are held the way alloc_from_slab takes blocks. The zone counts
+** as advised from here until its next free. Caller holds its lock.
+*/
+static bool slab_gather(t_slab *slab, t_purge_zone *pz)
+{
+  char      *page;
+  size_t    first;
+  size_t    last;
+  uint32_t  left;
+  int       i;
+
+  pz->slab = slab;
+  pz->page = (char *)(((uintptr_t)slab_data(slab) + PAGE_SIZE - 1)
+                      & ~(uintptr_t)(PAGE_SIZE - 1));
+  pz->end = slab_data(slab) + (size_t)slab->fresh * slab->block_size;
+  pz->words = 0;
+  pz->held = 0;
+  sea_bzero(pz->mask, sizeof(pz->mask));
+  slab->advised = 1;
+  for (page = pz->page; page < pz->end; page += PAGE_SIZE)
+    {
+      page_blocks(slab, page, &first, &last);
+      if (!blocks_are(slab->bitmap, first, last, false))
+        continue;
+      for (; first <= last; first++)
+        {
+          pz->mask[first / 64] |= 1ULL << (first % 64);
+          pz->words |= 1U << (first / 64);
+        }
+    }
+  left = pz->words;
+  while (left)
+    {
+      i = __builtin_ctz(left);
+      left &= left - 1;
+      slab->bitmap[i] |= pz->mask[i];
+      pz->held += __builtin_popcountll(pz->mask[i]);
+      if (slab->bitmap[i] == UINT64_MAX)
+        slab->summary &= ~(1U << i);
+    }
+  slab->free_count -= pz->held;
+  if (pz->held && slab->free_count == 0)
+    {
+      slab_unlink(heap_class_list(slab_heap(slab), slab->class_idx, 0), slab);
+      slab_push(heap_class_list(slab_heap(slab), slab->class_idx, 1), slab);
+    }
+  return (pz->held != 0);
+}
+
+// madvise [run, end) unless none of it is resident; the bytes that were
+static size_t run_purge(char *run, char *end)
+{
+  unsigned char vec[THP_SIZE / PAGE_SIZE];
+  size_t        resident;
+  size_t        i;
+
+  resident = end - run;
+  if (mincore(run, end - run, vec) == 0)
+    for (resident = 0, i = 0; i < (size_t)(end - run) / PAGE_SIZE; i++)
+      resident += (size_t)(vec[i] & 1) * PAGE_SIZE;
+  if (resident && madvise(run, end - run, MADV_DONTNEED) != 0)
+    return (0);
+  return (resident);
+}
+
+// Runs of held pages go back one madvise each (no lock held)
+static size_t zone_purge(t_purge_zone *pz)
+{
+  char    *page;
+  char    *run;
+  size_t  first;
+  size_t  last;
+  size_t  released;
+
+  released = 0;
+  run = NULL;
+  for (page = pz->page; page < pz->end || run; page += PAGE_SIZE)
+    {
+      if (page < pz->end)
+        {
+          page_blocks(pz->slab, page, &first, &last);
+          if (blocks_are(pz->mask, first, last, true))
+            {
+              if (!run)
+                run = page;
+              continue;
+            }
+        }
+      if (run)
+        released += run_purge(run, page);
+      run = NULL;
+    }
+  return (released);
+}
+
+// Held blocks back; the zone stays advised unless freed into meanwhile
+static void zone_return(t_purge_zone *pz)
+{
+  t_slab  *slab;
+  uint8_t advised;
+  bool    empty;
+
+  slab = pz->slab;
+  advised = slab->advised;
+  empty = (slab->free_count + pz->held == slab->total_blocks);
+  free_slab_blocks(slab, pz->mask, pz->words);
+  if (!empty)
+    slab->advised = advised;
+}
+
+/*
+** Partial zones of one list, PURGE_BATCH at a time: gathered under lock
+** (held by the caller), madvise'd without it, handed back under it.
+*/
+static size_t purge_list(pthread_mutex_t *lock, t_slab **list)
+{
+  t_purge_zone  zones[PURGE_BATCH];
+  t_slab        *slab;
+  t_slab        *next;
+  size_t        n;
+  size_t        i;
+  size_t        released;
+
+  released = 0;
+  do
+    {
+      n = 0;
+      for (slab = *list; slab && n < PURGE_BATCH; slab = next)
+        {
+          next = slab->next;
+          if (!slab->pinned && !slab->advised && slab_gather(slab, &zones[n]))
+            n++;
+        }
+      if (!n)
+        break;
+      pthread_mutex_unlock(lock);
+      for (i = 0; i < n; i++)
+        released += zone_purge(&zones[i]);
+      pthread_mutex_lock(lock);
+      for (i = 0; i < n; i++)
+        zone_return(&zones[i]);
+    }
+  while (n == PURGE_BATCH);
+  return (released);
+}
+
+/*
+** Every class: remote frees applied, then the pages of partial zones.
+** With release, retained empty zones are unmapped as well.
+*/
+static size_t purge_classes(bool release)
+{
+  int     i;
+  t_slab  *slab;
+  size_t  released;
+
+  released = 0;
+  for (i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+      pthread_mutex_lock(&g_class_lock[i].mutex);
+      remote_free_take(i, NULL, 0);
+      while (release && (slab = g_heap.empty[i]))
+        {
+          slab_unlink(&g_heap.empty[i], slab);
+          g_heap.empty_count[i]--;
+          released += (size_t)slab->zone_pages * PAGE_SIZE;
+          slab_release(slab);
+        }
+      released += purge_list(&g_class_lock[i].mutex, class_list(i, 0));
+      pthread_mutex_unlock(&g_class_lock[i].mutex);
+    }
+  return (released);
+}
+
+// Partial zones of the explicit heaps (their empties wait for destroy)
+static size_t purge_heaps(void)
+{
+  uint32_t    id;
+  int         i;
+  t_sea_heap  *heap;
+  size_t      released;
+
+  released = 0;
+  pthread_mutex_lock(&g_heaps.lock);
+  for (id = 1; id <= g_heaps.next_id; id++)
+    {
+      if (!(heap = g_heaps.table[id]))
+        continue;
+      pthread_mutex_lock(&heap->lock);
+      for (i = 0; i < NUM_SIZE_CLASSES; i++)
+        released += purge_list(&heap->lock,
+                               heap_class_list(&heap->heap, i, 0));
+      pthread_mutex_unlock(&heap->lock);
+    }
+  pthread_mutex_unlock(&g_heaps.lock);
+  return (released);
+}
+
+/*
+** glibc's malloc_trim: 1 if any memory went back to the kernel. pad is
+** how many bytes of LARGE cache may stay (the entries used last).
+*/
+__attribute__((visibility("default")))
+int sea_malloc_trim(size_t pad)
+{
+  size_t released;
+
+  tcache_flush();
+  released = purge_classes(true);
+  released += purge_heaps();
+  pthread_mutex_lock(&g_medium_lock.mutex);
+  released += medium_purge(true);
+  pthread_mutex_unlock(&g_medium_lock.mutex);
+  pthread_mutex_lock(&g_large_lock.mutex);
+  released += large_cache_trim(pad);
+  pthread_mutex_unlock(&g_large_lock.mutex);
+  return (released != 0);
+}
+
+/*
+** One background pass: retained memory decays as usual (released only
+** once idle), free pages of memory in use go right away.
+*/
+static void purge_pass(void)
+{
+  slab_decay(false);
+  purge_classes(false);
+  purge_heaps();
+  pthread_mutex_lock(&g_medium_lock.mutex);
+  medium_purge(false);
+  pthread_mutex_unlock(&g_medium_lock.mutex);
+}
+
+static void *purge_main(void *arg)
+{
+  struct timespec ts;
+  uint64_t        ns;
+
+  (void)arg;
+  pthread_mutex_lock(&g_purge.lock);
+  while (!g_purge.stop)
+    {
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      ns = (uint64_t)ts.tv_nsec + (uint64_t)g_purge.interval_ms * 1000000;
+      ts.tv_sec += ns / 1000000000;
+      ts.tv_nsec = ns % 1000000000;
+      while (!g_purge.stop
+             && pthread_cond_timedwait(&g_purge.cond, &g_purge.lock, &ts) == 0)
+        ;
+      if (g_purge.stop)
+        break;
+      pthread_mutex_unlock(&g_purge.lock);
+      purge_pass();
+      pthread_mutex_lock(&g_purge.lock);
+    }
+  pthread_mutex_unlock(&g_purge.lock);
+  return (NULL);
+}
+
+static void purge_cond_init(void)
+{
+  pthread_condattr_t attr;
+
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&g_purge.cond, &attr);
+  pthread_condattr_destroy(&attr);
+}
+
+/*
+** Purge every interval_ms from a thread of ours. Already running: only
+** the interval changes (from the next pass on).
+*/
+__attribute__((visibility("default")))
+bool sea_malloc_purge_start(uint32_t interval_ms)
+{
+  bool ok;
+
+  if (!interval_ms)
+    return (false);
+  pthread_mutex_lock(&g_purge.ctl);
+  pthread_mutex_lock(&g_purge.lock);
+  if (!g_purge.cond_ready)
+    purge_cond_init();
+  g_purge.cond_ready = 1;
+  g_purge.interval_ms = interval_ms;
+  ok = true;
+  if (!g_purge.running)
+    {
+      g_purge.stop = 0;
+      ok = (pthread_create(&g_purge.thread, NULL, purge_main, NULL) == 0);
+      g_purge.running = ok;
+    }
+  pthread_mutex_unlock(&g_purge.lock);
+  pthread_mutex_unlock(&g_purge.ctl);
+  return (ok);
+}
+
+__attribute__((visibility("default")))
+void sea_malloc_purge_stop(void)
+{
+  pthread_mutex_lock(&g_purge.ctl);
+  pthread_mutex_lock(&g_purge.lock);
+  if (g_purge.running)
+    {
+      g_purge.stop = 1;
+      pthread_cond_signal(&g_purge.cond);
+      pthread_mutex_unlock(&g_purge.lock);
+      pthread_join(g_purge.thread, NULL);
+      pthread_mutex_lock(&g_purge.lock);
+      g_purge.running = 0;
+    }
+  pthread_mutex_unlock(&g_purge.lock);
+  pthread_mutex_unlock(&g_purge.ctl);
+}
+
+void purge_fork_prepare(void)
+{
+  pthread_mutex_lock(&g_purge.lock);
+}
+
+void purge_fork_parent(void)
+{
+  pthread_mutex_unlock(&g_purge.lock);
+}
+
+// The thread stays with the parent (ctl may be held by a join there)
+void purge_fork_child(void)
+{
+  pthread_mutex_init(&g_purge.lock, NULL);
+  pthread_mutex_init(&g_purge.ctl, NULL);
+  if (g_purge.cond_ready)
+    purge_cond_init();
+  g_purge.running = 0;
+  g_purge.stop = 0;
+}
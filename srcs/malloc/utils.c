@@ -18,7 +18,7 @@
 /*      Filename: utils.c                                                     */
 /*      By: espadara <espadara@pirate.capn.gg>                                */
 /*      Created: 2025/11/11 23:00:59 by espadara                              */
-/*      Updated: 2025/11/23 16:52:28 by espadara                              */
+/*      Updated: 2026/10/17 19:41:34 by espadara                              */
 /*                                                                            */
 /* ************************************************************************** */
 
@@ -29,42 +29,109 @@ static inline bool is_in_slab(t_slab *slab, void *ptr)
     void *start;
     void *end;
 
-    start = (void *)((char *)slab + sizeof(t_slab));
+    start = (void *)slab_data(slab);
     end = (void *)((char *)start + (slab->total_blocks * slab->block_size));
 
     return (ptr >= start && ptr < end);
 }
 
+// ptr is the first byte of one of the slab's blocks
+bool is_slab_block(t_slab *slab, void *ptr)
+{
+    if (!is_in_slab(slab, ptr))
+        return (false);
+    return (((char *)ptr - slab_data(slab))
+            % slab->block_size == 0);
+}
+
+// Slab list of a TINY/SMALL class: 0 = partial, 1 = full, 2 = empty
+t_slab **heap_class_list(t_heap *heap, int class_idx, int list)
+{
+  if (list == 2)
+    return (&heap->empty[class_idx]);
+  if (class_idx < MAX_TINY_CLASSES)
+    return (list ? &heap->tiny_full[class_idx] : &heap->tiny[class_idx]);
+  return (list ? &heap->small_full[class_idx] : &heap->small[class_idx]);
+}
+
+t_slab **class_list(int class_idx, int list)
+{
+  return (heap_class_list(&g_heap, class_idx, list));
+}
+
+void slab_unlink(t_slab **head, t_slab *slab)
+{
+  if (slab->prev)
+    slab->prev->next = slab->next;
+  else
+    *head = slab->next;
+  if (slab->next)
+    slab->next->prev = slab->prev;
+}
+
+void slab_push(t_slab **head, t_slab *slab)
+{
+  slab->prev = NULL;
+  slab->next = *head;
+  if (*head)
+    (*head)->prev = slab;
+  *head = slab;
+}
+
+/*
+** Start of the mapping behind a LARGE header. Plain blocks have the header
+** at the mapping start, aligned ones right below their aligned pointer.
+*/
+void *large_map_base(t_slab *slab)
+{
+  return ((void *)((uintptr_t)slab & ~(uintptr_t)(PAGE_SIZE - 1)));
+}
+
+// Length of the mapping behind a LARGE header, as passed to mmap
+size_t large_map_size(t_slab *slab)
+{
+  uintptr_t end;
+
+  end = (uintptr_t)(slab + 1) + slab->block_size;
+  end = (end + (PAGE_SIZE - 1)) & ~(uintptr_t)(PAGE_SIZE - 1);
+  return (end - (uintptr_t)large_map_base(slab));
+}
+
+/*
+** O(1): the page map gives the owning header straight from the pointer bits.
+** TINY/SMALL zones register every page, LARGE blocks only the page the
+** user pointer (slab + 1) lives in.
+*/
 t_slab *find_slab_by_ptr(void *ptr, int *type_out)
 {
-  int i;
   t_slab *slab;
 
-  for (i = 0; i < MAX_TINY_CLASSES; i++)
-    {
-      slab = g_heap.tiny[i];
-      while (slab)
-        {
-          if (is_in_slab(slab, ptr))
-            {
-              if (type_out) *type_out = 0;
-              return (slab);
-            }
-          slab = slab->next;
-        }
-    }
-  for (i = 0; i < MAX_SMALL_CLASSES; i++)
-    {
-      slab = g_heap.small[i];
-      while (slab)
-        {
-          if (is_in_slab(slab, ptr))
-            {
-              if (type_out) *type_out = 1;
-              return (slab);
-            }
-          slab = slab->next;
-        }
-    }
-  return (NULL);
+  slab = pagemap_get(ptr);
+  if (!slab)
+    return (NULL);
+  if (slab->type == 2 && ptr != (void *)(slab + 1))
+    return (NULL);
+  if (slab->type == 3 && ptr != medium_run_addr(slab))
+    return (NULL);
+  if (slab->type < 2 && !is_in_slab(slab, ptr))
+    return (NULL);
+  if (type_out) *type_out = slab->type;
+  return (slab);
+}
+
+// Bytes the caller may use at ptr: the whole class block / run / mapping
+__attribute__((visibility("default")))
+size_t sea_malloc_usable_size(void *ptr)
+{
+  t_slab  *slab;
+  int     type;
+
+  if (!ptr || !(slab = find_slab_by_ptr(ptr, &type)))
+    return (0);
+  if (type < 2)
+    return (is_slab_block(slab, ptr) ? slab->block_size : 0);
+  if (type == 3)
+    return ((size_t)slab->total_blocks * PAGE_SIZE);
+  return ((size_t)((char *)large_map_base(slab) + large_map_size(slab)
+                   - (char *)ptr));
 }
@@ -0,0 +1,174 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: sea_preload.c                                               */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 18:10:05 by espadara                              */
+/*      Updated: 2026/10/17 21:43:53 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#define _GNU_SOURCE
+#include "sea_malloc.h"
+#include <dlfcn.h>
+#include <errno.h>
+
+/*
+** Drop-in replacement of the libc allocator:
+**   LD_PRELOAD=./libkraken_preload.so <program>
+** Only built into libkraken_preload.so, never into krakenlib.a, so linking
+** the library does not silently take over malloc.
+**
+** Pointers we don't own were handed out by glibc (through __libc_malloc
+** and friends), so they go back to glibc instead of being dropped.
+*/
+extern void	__libc_free(void *ptr) __attribute__((weak));
+extern void	*__libc_realloc(void *ptr, size_t size) __attribute__((weak));
+
+#define SEA_EXPORT __attribute__((visibility("default")))
+
+static inline bool is_ours(void *ptr)
+{
+  return (find_slab_by_ptr(ptr, NULL) != NULL);
+}
+
+static inline bool is_pow2(size_t n)
+{
+  return (n && !(n & (n - 1)));
+}
+
+static inline void *enomem(void *ptr)
+{
+  if (!ptr)
+    errno = ENOMEM;
+  return (ptr);
+}
+
+SEA_EXPORT
+void *malloc(size_t size)
+{
+  // malloc(0) must hand out a unique, freeable pointer
+  return (enomem(sea_malloc(size ? size : 1)));
+}
+
+SEA_EXPORT
+void free(void *ptr)
+{
+  if (!ptr)
+    return;
+  if (is_ours(ptr))
+    sea_free(ptr);
+  else if (__libc_free)
+    __libc_free(ptr);
+}
+
+SEA_EXPORT
+void *calloc(size_t count, size_t size)
+{
+  if (!count || !size)
+    count = size = 1;
+  return (enomem(sea_calloc(count, size)));
+}
+
+SEA_EXPORT
+void *realloc(void *ptr, size_t size)
+{
+  if (!ptr)
+    return (malloc(size));
+  if (!is_ours(ptr))
+    return (__libc_realloc ? __libc_realloc(ptr, size) : NULL);
+  if (size == 0)
+    {
+      sea_free(ptr);
+      return (NULL);
+    }
+  return (enomem(sea_realloc(ptr, size)));
+}
+
+SEA_EXPORT
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+  void *ptr;
+
+  if (!is_pow2(alignment) || alignment % sizeof(void *))
+    return (EINVAL);
+  if (!(ptr = sea_aligned_alloc(alignment, size ? size : 1)))
+    return (ENOMEM);
+  *memptr = ptr;
+  return (0);
+}
+
+SEA_EXPORT
+void *aligned_alloc(size_t alignment, size_t size)
+{
+  if (!is_pow2(alignment))
+    {
+      errno = EINVAL;
+      return (NULL);
+    }
+  return (enomem(sea_aligned_alloc(alignment, size ? size : 1)));
+}
+
+SEA_EXPORT
+void *memalign(size_t alignment, size_t size)
+{
+  // like glibc, a bad alignment is rounded up to the next power of two
+  return (enomem(sea_memalign(alignment, size ? size : 1)));
+}
+
+SEA_EXPORT
+void *valloc(size_t size)
+{
+  return (enomem(sea_aligned_alloc(PAGE_SIZE, size ? size : 1)));
+}
+
+SEA_EXPORT
+void *pvalloc(size_t size)
+{
+  if (size > SIZE_MAX - PAGE_SIZE)
+    return (enomem(NULL));
+  size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+  return (enomem(sea_aligned_alloc(PAGE_SIZE, size ? size : PAGE_SIZE)));
+}
+
+// glibc's own, looked up once, for the blocks it handed out
+static size_t libc_usable_size(void *ptr)
+{
+  static size_t (*real)(void *);
+
+  if (!real)
+    real = (size_t (*)(void *))dlsym(RTLD_NEXT, "malloc_usable_size");
+  return (real ? real(ptr) : 0);
+}
+
+SEA_EXPORT
+size_t malloc_usable_size(void *ptr)
+{
+  if (!ptr)
+    return (0);
+  if (!is_ours(ptr))
+    return (libc_usable_size(ptr));
+  return (sea_malloc_usable_size(ptr));
+}
+
+// Our heap only: glibc keeps whatever it handed out before we came in
+SEA_EXPORT
+int malloc_trim(size_t pad)
+{
+  return (sea_malloc_trim(pad));
+}
@@ -0,0 +1,739 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: malloc_bench_only.c                                         */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 19:29:14 by espadara                              */
+/*      Updated: 2026/10/17 19:47:15 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Allocator benchmark: sea_malloc against glibc malloc, scenario by
+** scenario. Every measurement runs in a fresh forked process, so neither
+** allocator starts on a heap the other (or an earlier scenario) shaped.
+**
+**   ./malloc_bench [-q] [-t max_threads]
+**
+** -q runs a tenth of the iterations. Threads scale 1, 2, 4 ... up to
+** max_threads (default: the online CPUs, at least 4).
+*/
+
+#include "krakenlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define MAX_RESULTS 16
+#define RING_SLOTS 1024
+
+typedef struct {
+    const char *name;
+    void *(*malloc)(size_t);
+    void (*free)(void *);
+    void *(*realloc)(void *, size_t);
+} allocator;
+
+static const allocator g_allocators[2] = {
+    {"Kraken", sea_malloc, sea_free, sea_realloc},
+    {"glibc", malloc, free, realloc},
+};
+
+// The allocator of this (child) process
+static const allocator *g_alloc;
+static double g_scale = 1.0;
+
+typedef void (*scenario)(const void *arg, double *out);
+
+static inline double get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline uint64_t rng_next(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+// Log-uniform in [lo, hi]: as many 16-32 B blocks as 4-8 KB ones
+static inline size_t random_size(uint64_t *s, size_t lo, size_t hi)
+{
+    int lg_lo = 63 - __builtin_clzll(lo);
+    int lg_hi = 63 - __builtin_clzll(hi);
+    uint64_t r = rng_next(s);
+    int lg = lg_lo + (int)(r % (lg_hi - lg_lo + 1));
+    size_t size = ((size_t)1 << lg) + (r >> 32) % ((size_t)1 << lg);
+
+    return size < lo ? lo : size > hi ? hi : size;
+}
+
+// One write per page: what a program using the block would fault in
+static inline void touch(char *p, size_t size)
+{
+    for (size_t off = 0; off < size; off += 4096)
+        p[off] = 1;
+}
+
+static size_t iters(size_t n)
+{
+    size_t scaled = (size_t)(n * g_scale);
+    return scaled ? scaled : 1;
+}
+
+static double rss_mb(void)
+{
+    long pages = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+
+    if (f) {
+        if (fscanf(f, "%*d %ld", &pages) != 1)
+            pages = 0;
+        fclose(f);
+    }
+    return pages * (double)sysconf(_SC_PAGESIZE) / (1024 * 1024);
+}
+
+// ============================================================
+// RUNNER
+// ============================================================
+
+// fn in a fresh process on allocator a, its results through shared memory
+static void run_child(const allocator *a, scenario fn, const void *arg,
+                      double *out)
+{
+    double *shared = mmap(NULL, MAX_RESULTS * sizeof(double),
+                          PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                          -1, 0);
+    int status = 0;
+    pid_t pid;
+
+    if (shared == MAP_FAILED)
+        exit(1);
+    memset(shared, 0, MAX_RESULTS * sizeof(double));
+    fflush(stdout);
+    if ((pid = fork()) == 0) {
+        g_alloc = a;
+        fn(arg, shared);
+        _exit(0);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+        || WEXITSTATUS(status))
+        fprintf(stderr, "  %s: scenario failed\n", a->name);
+    memcpy(out, shared, MAX_RESULTS * sizeof(double));
+    munmap(shared, MAX_RESULTS * sizeof(double));
+}
+
+// Positive: Kraken is better, whichever way "better" goes
+static void print_row(const char *name, double kraken, double libc,
+                      const char *unit, int higher_is_better)
+{
+    double gain = 0;
+
+    if (kraken > 0 && libc > 0)
+        gain = higher_is_better ? (kraken / libc - 1) * 100
+                                : (libc / kraken - 1) * 100;
+    printf("%-34s | %10.2f | %10.2f | %+9.1f%% | %s\n",
+           name, kraken, libc, gain, unit);
+}
+
+static void report(const char *name, scenario fn, const void *arg,
+                   const char *unit, int higher_is_better)
+{
+    double kraken[MAX_RESULTS];
+    double libc[MAX_RESULTS];
+
+    run_child(&g_allocators[0], fn, arg, kraken);
+    run_child(&g_allocators[1], fn, arg, libc);
+    print_row(name, kraken[0], libc[0], unit, higher_is_better);
+}
+
+static void print_header(const char *title)
+{
+    printf("\n%s\n", title);
+    printf("%-34s | %10s | %10s | %10s | %s\n",
+           "Scenario", "Kraken", "glibc", "Kraken gain", "Unit");
+    printf("--------------------------------------------------------------"
+           "------------------------\n");
+}
+
+// ============================================================
+// SINGLE THREAD: SIZE SWEEP, RANDOM SIZES, REALLOC CHAINS
+// ============================================================
+
+typedef struct {
+    size_t size;
+    size_t pairs;
+} sweep_arg;
+
+// Batches of 32 blocks of one size, freed in reverse: ns per malloc+free
+static void bench_sweep(const void *p, double *out)
+{
+    const sweep_arg *arg = p;
+    size_t rounds = iters(arg->pairs) / 32 + 1;
+    void *ptrs[32];
+    double start;
+
+    for (int pass = 0; pass < 2; pass++) { // the first one warms up
+        start = get_time();
+        for (size_t r = 0; r < (pass ? rounds : rounds / 10 + 1); r++) {
+            for (int i = 0; i < 32; i++) {
+                ptrs[i] = g_alloc->malloc(arg->size);
+                *(volatile char *)ptrs[i] = 1;
+            }
+            for (int i = 31; i >= 0; i--)
+                g_alloc->free(ptrs[i]);
+        }
+    }
+    out[0] = (get_time() - start) * 1e9 / (rounds * 32);
+}
+
+typedef struct {
+    size_t lo;
+    size_t hi;
+    size_t ops;
+} random_arg;
+
+// 4096 slots, each op frees a random one and refills it: Mops/s
+static void bench_random(const void *p, double *out)
+{
+    const random_arg *arg = p;
+    static void *slots[4096];
+    size_t ops = iters(arg->ops);
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    double start;
+
+    start = get_time();
+    for (size_t i = 0; i < ops; i++) {
+        size_t slot = rng_next(&rng) % 4096;
+        size_t size = random_size(&rng, arg->lo, arg->hi);
+
+        g_alloc->free(slots[slot]);
+        slots[slot] = g_alloc->malloc(size);
+        *(volatile char *)slots[slot] = 1;
+    }
+    out[0] = ops / (get_time() - start) / 1e6;
+    for (int i = 0; i < 4096; i++)
+        g_alloc->free(slots[i]);
+}
+
+// 8 buffers grown by half again, round robin, from 16 B to 1 MB with a
+// small block allocated between steps: ns per realloc
+static void bench_realloc_chains(const void *p, double *out)
+{
+    static void *keep[1 << 16];
+    char *chains[8];
+    size_t sizes[8];
+    size_t reallocs = 0;
+    size_t nkeep = 0;
+    size_t rounds = iters(200);
+    double start;
+
+    (void)p;
+    start = get_time();
+    for (size_t r = 0; r < rounds; r++) {
+        for (int c = 0; c < 8; c++) {
+            sizes[c] = 16;
+            chains[c] = g_alloc->malloc(16);
+        }
+        while (sizes[0] < 1024 * 1024) {
+            for (int c = 0; c < 8; c++) {
+                sizes[c] += sizes[c] / 2 + 16 * c;
+                chains[c] = g_alloc->realloc(chains[c], sizes[c]);
+                chains[c][sizes[c] - 1] = 1;
+                reallocs++;
+            }
+            if (nkeep < sizeof(keep) / sizeof(keep[0]))
+                keep[nkeep++] = g_alloc->malloc(48);
+        }
+        for (int c = 0; c < 8; c++)
+            g_alloc->free(chains[c]);
+    }
+    out[0] = (get_time() - start) * 1e9 / reallocs;
+    while (nkeep)
+        g_alloc->free(keep[--nkeep]);
+}
+
+// ============================================================
+// THREADS: CHURN, LARSON, PRODUCER/CONSUMER
+// ============================================================
+
+typedef struct {
+    pthread_barrier_t *barrier;
+    size_t ops;
+    uint64_t rng;
+    void *shared;
+    int role;
+} worker_arg;
+
+// n threads through fn, timed from the moment they're all at the start
+static double run_threads(int n, void *(*fn)(void *), worker_arg *args)
+{
+    pthread_barrier_t barrier;
+    pthread_t threads[256];
+    double start;
+
+    pthread_barrier_init(&barrier, NULL, n + 1);
+    for (int i = 0; i < n; i++) {
+        args[i].barrier = &barrier;
+        args[i].rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+        if (pthread_create(&threads[i], NULL, fn, &args[i]))
+            exit(1);
+    }
+    pthread_barrier_wait(&barrier);
+    start = get_time();
+    for (int i = 0; i < n; i++)
+        pthread_join(threads[i], NULL);
+    pthread_barrier_destroy(&barrier);
+    return get_time() - start;
+}
+
+// Every thread on its own 1024 slots, 16 B - 1 KB
+static void *churn_worker(void *p)
+{
+    worker_arg *arg = p;
+    void *slots[1024] = {0};
+
+    pthread_barrier_wait(arg->barrier);
+    for (size_t i = 0; i < arg->ops; i++) {
+        size_t slot = rng_next(&arg->rng) % 1024;
+
+        g_alloc->free(slots[slot]);
+        slots[slot] = g_alloc->malloc(random_size(&arg->rng, 16, 1024));
+        *(volatile char *)slots[slot] = 1;
+    }
+    for (int i = 0; i < 1024; i++)
+        g_alloc->free(slots[i]);
+    return NULL;
+}
+
+static void bench_churn(const void *p, double *out)
+{
+    int n = *(const int *)p;
+    worker_arg args[256] = {{0}};
+
+    for (int i = 0; i < n; i++)
+        args[i].ops = iters(1000000);
+    out[0] = n * iters(1000000) / run_threads(n, churn_worker, args) / 1e6;
+}
+
+/*
+** Larson: a thread replaces random blocks of its set for a while, then
+** hands the set to a new thread and exits. Every generation frees what
+** the one before allocated (and the first, what the main thread did).
+*/
+typedef struct {
+    void *blocks[1024];
+    size_t rounds;
+    int generations;
+    uint64_t rng;
+    pthread_mutex_t *lock;
+    pthread_cond_t *done;
+    int *running;
+} larson_set;
+
+static void *larson_worker(void *p)
+{
+    larson_set *set = p;
+    pthread_attr_t attr;
+    pthread_t next;
+
+    for (size_t r = 0; r < set->rounds; r++) {
+        size_t i = rng_next(&set->rng) % 1024;
+
+        g_alloc->free(set->blocks[i]);
+        set->blocks[i] = g_alloc->malloc(random_size(&set->rng, 16, 512));
+        *(volatile char *)set->blocks[i] = 1;
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (--set->generations > 0
+        && pthread_create(&next, &attr, larson_worker, set) == 0) {
+        pthread_attr_destroy(&attr);
+        return NULL;
+    }
+    pthread_attr_destroy(&attr);
+    pthread_mutex_lock(set->lock);
+    if (--*set->running == 0)
+        pthread_cond_signal(set->done);
+    pthread_mutex_unlock(set->lock);
+    return NULL;
+}
+
+static void bench_larson(const void *p, double *out)
+{
+    int n = *(const int *)p;
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t done = PTHREAD_COND_INITIALIZER;
+    larson_set *sets = calloc(n, sizeof(*sets));
+    pthread_attr_t attr;
+    pthread_t thread;
+    int running = n;
+    double start;
+
+    if (!sets)
+        exit(1);
+    for (int t = 0; t < n; t++) {
+        sets[t].rng = 0x9E3779B97F4A7C15ULL * (t + 1);
+        for (int i = 0; i < 1024; i++)
+            sets[t].blocks[i] = g_alloc->malloc(random_size(&sets[t].rng, 16, 512));
+        sets[t].rounds = iters(50000);
+        sets[t].generations = 20;
+        sets[t].lock = &lock;
+        sets[t].done = &done;
+        sets[t].running = &running;
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    start = get_time();
+    for (int t = 0; t < n; t++)
+        if (pthread_create(&thread, &attr, larson_worker, &sets[t]))
+            exit(1);
+    pthread_mutex_lock(&lock);
+    while (running)
+        pthread_cond_wait(&done, &lock);
+    pthread_mutex_unlock(&lock);
+    out[0] = n * 20.0 * iters(50000) / (get_time() - start) / 1e6;
+    pthread_attr_destroy(&attr);
+    for (int t = 0; t < n; t++)
+        for (int i = 0; i < 1024; i++)
+            g_alloc->free(sets[t].blocks[i]);
+    free(sets);
+}
+
+// One producer allocates, its consumer frees, through a lock-free ring
+typedef struct {
+    void *slots[RING_SLOTS];
+    uint64_t head;
+    uint64_t tail;
+} pc_ring;
+
+static void *producer(void *p)
+{
+    worker_arg *arg = p;
+    pc_ring *ring = arg->shared;
+
+    pthread_barrier_wait(arg->barrier);
+    for (size_t i = 0; i < arg->ops; i++) {
+        void *block = g_alloc->malloc(random_size(&arg->rng, 16, 512));
+
+        *(volatile char *)block = 1;
+        while (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)
+               == RING_SLOTS)
+            sched_yield();
+        ring->slots[ring->head % RING_SLOTS] = block;
+        __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void *consumer(void *p)
+{
+    worker_arg *arg = p;
+    pc_ring *ring = arg->shared;
+
+    pthread_barrier_wait(arg->barrier);
+    for (size_t i = 0; i < arg->ops; i++) {
+        while (ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+            sched_yield();
+        g_alloc->free(ring->slots[ring->tail % RING_SLOTS]);
+        __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+// Even threads produce, odd ones consume what their neighbour made
+static void *pc_worker(void *p)
+{
+    return ((worker_arg *)p)->role ? consumer(p) : producer(p);
+}
+
+static void bench_prodcons(const void *p, double *out)
+{
+    int n = *(const int *)p;
+    int pairs = n < 2 ? 1 : n / 2;
+    worker_arg args[256] = {{0}};
+    pc_ring *rings = calloc(pairs, sizeof(*rings));
+    size_t ops = iters(1000000);
+
+    if (!rings)
+        exit(1);
+    for (int i = 0; i < 2 * pairs; i++) {
+        args[i].shared = &rings[i / 2];
+        args[i].ops = ops;
+        args[i].role = i & 1;
+    }
+    out[0] = pairs * (double)ops / run_threads(2 * pairs, pc_worker, args) / 1e6;
+    free(rings);
+}
+
+// ============================================================
+// FRAGMENTATION OVER TIME
+// ============================================================
+
+#define FRAG_PHASES 6
+
+static const char *g_frag_phases[FRAG_PHASES] = {
+    "100k x 16 B - 2 KB",
+    "90% freed",
+    "+ 3k x 4 KB - 32 KB",
+    "1M replaced at random",
+    "big + half freed",
+    "idle 2 s + one malloc",
+};
+
+/*
+** RSS (MB) after each phase in out[phase], the live bytes in
+** out[FRAG_PHASES + phase]. Every block is written through: RSS is what
+** the allocator keeps resident, over what the program holds.
+*/
+static void bench_fragmentation(const void *p, double *out)
+{
+    size_t nsmall = 100000;
+    size_t nbig = 3000;
+    void **small = calloc(nsmall, sizeof(void *));
+    size_t *small_size = calloc(nsmall, sizeof(size_t));
+    void **big = calloc(nbig, sizeof(void *));
+    uint64_t rng = 0x2545F4914F6CDD1DULL;
+    double live = 0;
+    size_t i;
+
+    (void)p;
+    if (!small || !small_size || !big)
+        exit(1);
+    for (i = 0; i < nsmall; i++) {
+        small_size[i] = random_size(&rng, 16, 2048);
+        small[i] = g_alloc->malloc(small_size[i]);
+        memset(small[i], 1, small_size[i]);
+        live += small_size[i];
+    }
+    out[0] = rss_mb();
+    out[FRAG_PHASES] = live / (1024 * 1024);
+
+    for (i = 0; i < nsmall; i++)
+        if (rng_next(&rng) % 10) {
+            g_alloc->free(small[i]);
+            live -= small_size[i];
+            small[i] = NULL;
+        }
+    out[1] = rss_mb();
+    out[FRAG_PHASES + 1] = live / (1024 * 1024);
+
+    for (i = 0; i < nbig; i++) {
+        size_t size = random_size(&rng, 4096, 32768);
+
+        big[i] = g_alloc->malloc(size);
+        memset(big[i], 1, size);
+        live += size;
+    }
+    out[2] = rss_mb();
+    out[FRAG_PHASES + 2] = live / (1024 * 1024);
+
+    for (size_t n = iters(1000000); n; n--) {
+        i = rng_next(&rng) % nsmall;
+        if (small[i]) {
+            g_alloc->free(small[i]);
+            live -= small_size[i];
+        }
+        small_size[i] = random_size(&rng, 16, 2048);
+        small[i] = g_alloc->malloc(small_size[i]);
+        touch(small[i], small_size[i]);
+        *((char *)small[i] + small_size[i] - 1) = 1;
+        live += small_size[i];
+    }
+    out[3] = rss_mb();
+    out[FRAG_PHASES + 3] = live / (1024 * 1024);
+
+    for (i = 0; i < nbig; i++)
+        g_alloc->free(big[i]);
+    live = 0;
+    for (i = 0; i < nsmall; i++) {
+        if (small[i] && (i & 1)) {
+            g_alloc->free(small[i]);
+            small[i] = NULL;
+        }
+        live += small[i] ? small_size[i] : 0;
+    }
+    out[4] = rss_mb();
+    out[FRAG_PHASES + 4] = live / (1024 * 1024);
+
+    // what an idle heap gives back on its own
+    sleep(2);
+    g_alloc->free(g_alloc->malloc(64));
+    out[5] = rss_mb();
+    out[FRAG_PHASES + 5] = live / (1024 * 1024);
+    for (i = 0; i < nsmall; i++)
+        g_alloc->free(small[i]);
+    free(small);
+    free(small_size);
+    free(big);
+}
+
+static void report_fragmentation(void)
+{
+    double kraken[MAX_RESULTS];
+    double libc[MAX_RESULTS];
+    char name[64];
+
+    run_child(&g_allocators[0], bench_fragmentation, NULL, kraken);
+    run_child(&g_allocators[1], bench_fragmentation, NULL, libc);
+    for (int i = 0; i < FRAG_PHASES; i++) {
+        snprintf(name, sizeof(name), "%s, %.0f MB live",
+                 g_frag_phases[i], kraken[FRAG_PHASES + i]);
+        print_row(name, kraken[i], libc[i], "RSS MB, lower is better", 0);
+    }
+}
+
+// ============================================================
+// CACHE SET ALIASING
+// ============================================================
+
+typedef struct {
+    size_t size;
+    size_t stride;
+    int heads;
+} heads_arg;
+
+/*
+** heads pools of stride blocks each (one Kraken slab of the class), and
+** the first block of every pool is the hot one: ns per load, chasing a
+** pointer through the heads. Heads at one page offset share an L1 set.
+*/
+static void bench_heads(const void *p, double *out)
+{
+    const heads_arg *arg = p;
+    size_t count = arg->stride * arg->heads;
+    size_t loads = iters(100000000);
+    void **blocks = calloc(count, sizeof(void *));
+    void **head[64];
+    void **cur;
+    double start;
+
+    for (size_t i = 0; i < count; i++)
+        blocks[i] = g_alloc->malloc(arg->size);
+    for (int h = 0; h < arg->heads; h++)
+        head[h] = blocks[h * arg->stride];
+    for (int h = 0; h < arg->heads; h++)
+        *head[h] = head[(h + 1) % arg->heads];
+    cur = head[0];
+    for (size_t i = 0; i < loads / 10; i++)
+        cur = *cur;
+    start = get_time();
+    for (size_t i = 0; i < loads; i++)
+        cur = *cur;
+    out[0] = (get_time() - start) * 1e9 / loads;
+    *(void *volatile *)head[0] = cur;
+    for (size_t i = 0; i < count; i++)
+        g_alloc->free(blocks[i]);
+    free(blocks);
+}
+
+// ============================================================
+// MAIN
+// ============================================================
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = cpus > 4 ? (int)cpus : 4;
+    char name[64];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "qt:")) != -1) {
+        if (opt == 'q')
+            g_scale = 0.1;
+        else if (opt == 't' && atoi(optarg) > 0)
+            max_threads = atoi(optarg) > 128 ? 128 : atoi(optarg);
+        else {
+            fprintf(stderr, "usage: %s [-q] [-t max_threads]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("\n");
+    printf("🐙 ============================================== 🐙\n");
+    printf("       KRAKENLIB ALLOCATOR BENCHMARK\n");
+    printf("🐙 ============================================== 🐙\n");
+    printf("\n  %ld CPU(s), up to %d threads, scale %.1f\n", cpus, max_threads,
+           g_scale);
+
+    print_header("Size sweep (1 thread, batches of 32, malloc + free):");
+    static const sweep_arg sweep[] = {
+        {16, 4000000}, {128, 4000000}, {129, 4000000}, {1024, 4000000},
+        {8192, 2000000}, {8193, 1000000}, {65536, 500000},
+        {512 * 1024, 100000}, {512 * 1024 + 1, 20000},
+        {1024 * 1024, 20000}, {4 * 1024 * 1024, 10000},
+    };
+    for (size_t i = 0; i < sizeof(sweep) / sizeof(sweep[0]); i++) {
+        snprintf(name, sizeof(name), "malloc(%zu)", sweep[i].size);
+        report(name, bench_sweep, &sweep[i], "ns per pair, lower is better", 0);
+    }
+
+    print_header("Random sizes (1 thread, 4096 live, log-uniform):");
+    static const random_arg random[] = {
+        {16, 1024, 4000000}, {16, 8192, 4000000}, {16, 1024 * 1024, 200000},
+    };
+    for (size_t i = 0; i < sizeof(random) / sizeof(random[0]); i++) {
+        snprintf(name, sizeof(name), "random %zu B - %zu KB", random[i].lo,
+                 random[i].hi / 1024);
+        report(name, bench_random, &random[i], "Mops/s, higher is better", 1);
+    }
+
+    print_header("Realloc growth (8 chains, 16 B -> 1 MB by x1.5):");
+    report("realloc chains", bench_realloc_chains, NULL,
+           "ns per realloc, lower is better", 0);
+
+    print_header("Threads, 1 to N:");
+    for (int n = 1; n <= max_threads; n = n * 2 > max_threads && n < max_threads
+                                        ? max_threads : n * 2) {
+        snprintf(name, sizeof(name), "churn x%d (thread-local)", n);
+        report(name, bench_churn, &n, "Mops/s, higher is better", 1);
+        snprintf(name, sizeof(name), "larson x%d (cross-thread frees)", n);
+        report(name, bench_larson, &n, "Mops/s, higher is better", 1);
+        if (n > 1) {
+            snprintf(name, sizeof(name), "producer/consumer x%d", n);
+            report(name, bench_prodcons, &n, "Mops/s, higher is better", 1);
+        }
+    }
+
+    print_header("Cache set aliasing (first block of each slab, chased):");
+    static const heads_arg heads[] = {
+        {3584, 292, 16}, {5120, 204, 16}, {448, 1023, 16},
+    };
+    for (size_t i = 0; i < sizeof(heads) / sizeof(heads[0]); i++) {
+        snprintf(name, sizeof(name), "%d heads of %zu B", heads[i].heads,
+                 heads[i].size);
+        report(name, bench_heads, &heads[i], "ns per load, lower is better", 0);
+    }
+
+    print_header("Fragmentation over time (RSS after each phase, live MB):");
+    report_fragmentation();
+
+    printf("\n🐙 Benchmark Complete! 🐙\n\n");
+    return 0;
+}
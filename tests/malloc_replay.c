@@ -0,0 +1,387 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: malloc_replay.c                                             */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2026/10/17 19:23:44 by espadara                              */
+/*      Updated: 2026/10/17 19:23:44 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Replay a sea_malloc allocation trace (KRAKEN_MALLOC_TRACE=<file> or
+** sea_malloc_trace_start) against sea_malloc and glibc malloc.
+**
+**   ./malloc_replay <trace> [sea|glibc]
+**
+** Events are merged across threads by timestamp and replayed on one
+** thread, each allocator in its own forked child:
+**   - throughput: the whole trace, no per-call timer
+**   - latency:    every call timed (timer overhead taken off)
+**   - peak RSS:   one byte written per page handed out, peak over start
+*/
+
+#include "krakenlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define OP_SKIP UINT32_MAX
+
+// One call, pointers already turned into slots of the live table
+typedef struct {
+    uint32_t op;
+    uint32_t slot;
+    uint64_t size;
+    uint64_t align;
+} replay_op;
+
+typedef struct {
+    const char *name;
+    void *(*malloc)(size_t);
+    void (*free)(void *);
+    void *(*realloc)(void *, size_t);
+    void *(*calloc)(size_t, size_t);
+    void *(*aligned_alloc)(size_t, size_t);
+} allocator;
+
+typedef struct {
+    replay_op *ops;
+    size_t count;
+    size_t slots;
+    size_t events;
+    size_t unmatched;
+    uint32_t threads;
+} replay_trace;
+
+static const allocator g_allocators[] = {
+    {"sea_malloc", sea_malloc, sea_free, sea_realloc, sea_calloc,
+     sea_aligned_alloc},
+    {"glibc malloc", malloc, free, realloc, calloc, aligned_alloc},
+};
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// ============================================================
+// LOADING: events -> ops on slots
+// ============================================================
+
+static int by_time(const void *a, const void *b)
+{
+    const t_trace_event *x = a;
+    const t_trace_event *y = b;
+
+    if (x->ns != y->ns)
+        return x->ns < y->ns ? -1 : 1;
+    // thread holds the position in the file by now: file order on ties
+    return (x->thread > y->thread) - (x->thread < y->thread);
+}
+
+// Recorded pointer -> slot, open addressing with backward-shift delete
+typedef struct {
+    uint64_t *keys;
+    uint32_t *vals;
+    size_t mask;
+} ptr_map;
+
+static size_t map_find(ptr_map *m, uint64_t key)
+{
+    size_t i = (key >> 4) * 0x9E3779B97F4A7C15ULL >> 20 & m->mask;
+
+    while (m->keys[i] && m->keys[i] != key)
+        i = (i + 1) & m->mask;
+    return i;
+}
+
+static void map_delete(ptr_map *m, size_t hole)
+{
+    size_t i = hole;
+    size_t home;
+
+    m->keys[hole] = 0;
+    for (;;) {
+        i = (i + 1) & m->mask;
+        if (!m->keys[i])
+            return;
+        home = (m->keys[i] >> 4) * 0x9E3779B97F4A7C15ULL >> 20 & m->mask;
+        if (((i - home) & m->mask) >= ((i - hole) & m->mask)) {
+            m->keys[hole] = m->keys[i];
+            m->vals[hole] = m->vals[i];
+            m->keys[i] = 0;
+            hole = i;
+        }
+    }
+}
+
+static int load_trace(const char *path, replay_trace *tr)
+{
+    t_trace_header hdr;
+    t_trace_event *ev;
+    uint32_t *free_slots;
+    size_t nfree = 0;
+    ptr_map m;
+    size_t i;
+    size_t at;
+    off_t len;
+    int fd;
+
+    memset(tr, 0, sizeof(*tr));
+    if ((fd = open(path, O_RDONLY)) < 0 || read(fd, &hdr, sizeof(hdr)) != sizeof(hdr)
+        || memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic))
+        || hdr.version != TRACE_VERSION || hdr.event_size != sizeof(t_trace_event)) {
+        fprintf(stderr, "%s: not a version %d trace\n", path, TRACE_VERSION);
+        return -1;
+    }
+    len = lseek(fd, 0, SEEK_END) - (off_t)sizeof(hdr);
+    tr->events = len / sizeof(t_trace_event);
+    ev = malloc(tr->events * sizeof(*ev) + 1);
+    if (!ev || pread(fd, ev, tr->events * sizeof(*ev), sizeof(hdr))
+               != (ssize_t)(tr->events * sizeof(*ev))) {
+        fprintf(stderr, "%s: short read\n", path);
+        return -1;
+    }
+    close(fd);
+    for (i = 0; i < tr->events; i++) {
+        if (ev[i].thread != UINT32_MAX && ev[i].thread >= tr->threads)
+            tr->threads = ev[i].thread + 1;
+        ev[i].thread = i;
+    }
+    qsort(ev, tr->events, sizeof(*ev), by_time);
+
+    m.mask = 1024;
+    while (m.mask < tr->events * 2)
+        m.mask <<= 1;
+    m.keys = calloc(m.mask, sizeof(*m.keys));
+    m.vals = calloc(m.mask, sizeof(*m.vals));
+    m.mask--;
+    tr->ops = calloc(tr->events + 1, sizeof(*tr->ops));
+    free_slots = calloc(tr->events + 1, sizeof(*free_slots));
+    if (!m.keys || !m.vals || !tr->ops || !free_slots)
+        return -1;
+
+    for (i = 0; i < tr->events; i++) {
+        replay_op *op = &tr->ops[tr->count];
+        uint64_t gone = 0;
+        uint32_t slot = OP_SKIP;
+
+        op->op = ev[i].op;
+        op->size = ev[i].size;
+        op->align = ev[i].op == TRACE_ALIGNED ? ev[i].old : 0;
+        // the block given back (free, realloc's input) leaves the map
+        if (ev[i].op == TRACE_FREE || (ev[i].op == TRACE_REALLOC && ev[i].old))
+            gone = ev[i].op == TRACE_FREE ? ev[i].ptr : ev[i].old;
+        if (ev[i].op == TRACE_REALLOC && ev[i].ptr == 0 && ev[i].size)
+            continue; // failed, the old block is still live
+        if (gone) {
+            at = map_find(&m, gone);
+            if (!m.keys[at]) {
+                tr->unmatched++;
+                continue;
+            }
+            slot = m.vals[at];
+            map_delete(&m, at);
+        }
+        if (ev[i].op == TRACE_REALLOC && !ev[i].ptr)
+            op->op = TRACE_FREE; // realloc(p, 0)
+        if (op->op != TRACE_FREE) {
+            if (!ev[i].ptr)
+                continue; // failed allocation
+            if (slot == OP_SKIP)
+                slot = nfree ? free_slots[--nfree] : tr->slots++;
+            at = map_find(&m, ev[i].ptr);
+            if (m.keys[at])
+                tr->unmatched++; // never freed as far as the trace knows
+            m.keys[at] = ev[i].ptr;
+            m.vals[at] = slot;
+        } else
+            free_slots[nfree++] = slot;
+        op->slot = slot;
+        tr->count++;
+    }
+    free(ev);
+    free(m.keys);
+    free(m.vals);
+    free(free_slots);
+    return 0;
+}
+
+// ============================================================
+// REPLAY
+// ============================================================
+
+static inline void run_op(const allocator *a, const replay_op *op, void **slots)
+{
+    void **p = &slots[op->slot];
+
+    switch (op->op) {
+    case TRACE_MALLOC:  *p = a->malloc(op->size); break;
+    case TRACE_CALLOC:  *p = a->calloc(1, op->size); break;
+    case TRACE_ALIGNED: *p = a->aligned_alloc(op->align, op->size); break;
+    case TRACE_REALLOC: *p = a->realloc(*p, op->size); break;
+    default:            a->free(*p); *p = NULL; break;
+    }
+}
+
+static void free_all(const allocator *a, void **slots, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        a->free(slots[i]);
+        slots[i] = NULL;
+    }
+}
+
+static long max_rss_kb(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+static int by_value(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Cheapest back-to-back timer read: taken off every sample
+static uint64_t timer_overhead(void)
+{
+    uint64_t best = UINT64_MAX;
+
+    for (int i = 0; i < 10000; i++) {
+        uint64_t t0 = now_ns();
+        uint64_t t1 = now_ns();
+        if (t1 - t0 < best)
+            best = t1 - t0;
+    }
+    return best;
+}
+
+static void replay(const allocator *a, const replay_trace *tr)
+{
+    void **slots = calloc(tr->slots + 1, sizeof(*slots));
+    uint32_t *lat = calloc(tr->count + 1, sizeof(*lat));
+    uint64_t overhead;
+    uint64_t start;
+    uint64_t elapsed;
+    long rss;
+    size_t i;
+
+    if (!slots || !lat)
+        exit(1);
+    // everything of ours resident before the baseline
+    memset(slots, 0, (tr->slots + 1) * sizeof(*slots));
+    memset(lat, 0, (tr->count + 1) * sizeof(*lat));
+
+    // peak RSS, the one pass that writes to the blocks
+    rss = max_rss_kb();
+    for (i = 0; i < tr->count; i++) {
+        const replay_op *op = &tr->ops[i];
+        char *p;
+
+        run_op(a, op, slots);
+        if (op->op != TRACE_FREE && (p = slots[op->slot]))
+            for (size_t off = 0; off < op->size; off += 4096)
+                p[off] = 1;
+    }
+    rss = max_rss_kb() - rss;
+    free_all(a, slots, tr->slots);
+
+    // throughput
+    start = now_ns();
+    for (i = 0; i < tr->count; i++)
+        run_op(a, &tr->ops[i], slots);
+    elapsed = now_ns() - start;
+    free_all(a, slots, tr->slots);
+
+    // latency
+    overhead = timer_overhead();
+    for (i = 0; i < tr->count; i++) {
+        uint64_t t0 = now_ns();
+        run_op(a, &tr->ops[i], slots);
+        uint64_t t = now_ns() - t0;
+        t = t > overhead ? t - overhead : 0;
+        lat[i] = t > UINT32_MAX ? UINT32_MAX : t;
+    }
+    free_all(a, slots, tr->slots);
+    qsort(lat, tr->count, sizeof(*lat), by_value);
+
+#define PCT(q) lat[(size_t)((tr->count - 1) * (q))]
+    printf("%-14s | %8.2f | %8u | %8u | %8u | %8u | %9u | %11ld\n",
+           a->name, elapsed ? tr->count * 1e3 / elapsed : 0.0,
+           PCT(0.5), PCT(0.9), PCT(0.99), PCT(0.999),
+           lat[tr->count - 1], rss);
+#undef PCT
+    fflush(stdout);
+    free(slots);
+    free(lat);
+}
+
+int main(int argc, char **argv)
+{
+    replay_trace tr;
+    size_t n = sizeof(g_allocators) / sizeof(g_allocators[0]);
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s <trace> [sea|glibc]\n", argv[0]);
+        return 2;
+    }
+    if (load_trace(argv[1], &tr) < 0)
+        return 1;
+    printf("\n🐙 Replaying %s: %zu events from %u thread(s)\n", argv[1],
+           tr.events, tr.threads);
+    printf("   %zu calls, %zu live at most, %zu unmatched\n\n",
+           tr.count, tr.slots, tr.unmatched);
+    if (!tr.count)
+        return 0;
+
+    printf("%-14s | %8s | %8s | %8s | %8s | %8s | %9s | %11s\n", "Allocator",
+           "Mops/s", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns",
+           "peak RSS KB");
+    printf("---------------------------------------------------------------"
+           "------------------------------------\n");
+    fflush(stdout);
+    for (size_t i = 0; i < n; i++) {
+        pid_t pid;
+        int status;
+
+        if (argc == 3 && strncmp(argv[2], g_allocators[i].name, strlen(argv[2])))
+            continue;
+        // a fresh process each: neither allocator inherits the other's heap
+        if ((pid = fork()) == 0) {
+            replay(&g_allocators[i], &tr);
+            _exit(0);
+        }
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+            || WEXITSTATUS(status))
+            fprintf(stderr, "%s: replay failed\n", g_allocators[i].name);
+    }
+    printf("\n");
+    return 0;
+}
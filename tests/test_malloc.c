@@ -1,312 +1,1872 @@
-/* ************************************************************************** */
-/*                                                                            */
-/*                        ______                                              */
-/*                     .-"      "-.                                           */
-/*                    /            \                                          */
-/*        _          |              |          _                              */
-/*       ( \         |,  .-.  .-.  ,|         / )                             */
-/*        > "=._     | )(__/  \__)( |     _.=" <                              */
-/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
-/*              "=._ (_     ^^     _)"_.="                                    */
-/*                  "=\__|IIIIII|__/="                                        */
-/*                 _.="| \IIIIII/ |"=._                                       */
-/*       _     _.="_.="\          /"=._"=._     _                             */
-/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
-/*       > _.="                            "=._ <                             */
-/*      (_/                                    \_)                            */
-/*                                                                            */
-/*      Filename: test.c                                                      */
-/*      By: espadara <espadara@pirate.capn.gg>                                */
-/*      Created: 2025/11/11 22:41:16 by espadara                              */
-/*      Updated: 2025/11/23 18:21:54 by espadara                              */
-/*                                                                            */
-/* ************************************************************************** */
-#include "krakenlib.h"
-#include <stdio.h>
-
-#include "krakenlib.h"
-#include <stdio.h>
-#include <string.h>
-#include <assert.h>
-
-#define TEST_COUNT 50
-#define STRESS_TEST_COUNT 1000
-
-void test_basic_allocations(void)
-{
-    printf("\n🔹 TEST 1: Basic Allocations\n");
-
-    void *ptr1 = sea_malloc(10);
-    void *ptr2 = sea_malloc(100);
-    void *ptr3 = sea_malloc(1000);
-    void *ptr4 = sea_malloc(10000);
-
-    assert(ptr1 != NULL);
-    assert(ptr2 != NULL);
-    assert(ptr3 != NULL);
-    assert(ptr4 != NULL);
-
-    // Write to them
-    memset(ptr1, 'A', 10);
-    memset(ptr2, 'B', 100);
-    memset(ptr3, 'C', 1000);
-    memset(ptr4, 'D', 10000);
-
-    // Verify
-    assert(((char*)ptr1)[0] == 'A');
-    assert(((char*)ptr2)[0] == 'B');
-    assert(((char*)ptr3)[0] == 'C');
-    assert(((char*)ptr4)[0] == 'D');
-
-    sea_free(ptr1);
-    sea_free(ptr2);
-    sea_free(ptr3);
-    sea_free(ptr4);
-
-    printf("  ✅ Basic allocations work!\n");
-}
-
-void test_zone_boundaries(void)
-{
-    printf("\n🔹 TEST 2: Zone Boundaries\n");
-
-    // Test TINY zone boundary (64 bytes)
-    void *tiny_max = sea_malloc(64);
-    void *tiny_over = sea_malloc(65);
-
-    // Test SMALL zone boundary (1024 bytes)
-    void *small_max = sea_malloc(1024);
-    void *small_over = sea_malloc(1025);
-
-    assert(tiny_max != NULL);
-    assert(tiny_over != NULL);
-    assert(small_max != NULL);
-    assert(small_over != NULL);
-
-    printf("  TINY max (64):    %p\n", tiny_max);
-    printf("  TINY over (65):   %p\n", tiny_over);
-    printf("  SMALL max (1024): %p\n", small_max);
-    printf("  SMALL over (1025): %p\n", small_over);
-
-    sea_free(tiny_max);
-    sea_free(tiny_over);
-    sea_free(small_max);
-    sea_free(small_over);
-
-    printf("  ✅ Zone boundaries work!\n");
-}
-
-void test_zero_and_null(void)
-{
-    printf("\n🔹 TEST 3: Zero Size and NULL\n");
-
-    void *zero = sea_malloc(0);
-    printf("  sea_malloc(0) returned: %p\n", zero);
-
-    sea_free(NULL);  // Should not crash
-    printf("  sea_free(NULL) didn't crash\n");
-
-    sea_free(zero);
-
-    printf("  ✅ Edge cases handled!\n");
-}
-
-void test_realloc(void)
-{
-    printf("\n🔹 TEST 4: Realloc Tests\n");
-
-    char *ptr = sea_malloc(50);
-    printf("  sea_malloc(50) = %p\n", ptr);
-    assert(ptr != NULL);
-
-    strcpy(ptr, "Hello, Kraken!");
-    printf("  Original (50 bytes): '%s' at %p\n", ptr, ptr);
-
-    // Grow
-    printf("  Calling sea_realloc(%p, 100)...\n", ptr);
-    ptr = sea_realloc(ptr, 100);
-    printf("  sea_realloc(100) returned: %p\n", ptr);
-    assert(ptr != NULL);
-    assert(strcmp(ptr, "Hello, Kraken!") == 0);
-    printf("  After sea_realloc(100): '%s'\n", ptr);
-
-    // Shrink
-    printf("  Calling sea_realloc(%p, 20)...\n", ptr);
-    ptr = sea_realloc(ptr, 20);
-    printf("  sea_realloc(20) returned: %p\n", ptr);
-    assert(ptr != NULL);
-    printf("  After sea_realloc(20): '%s'\n", ptr);
-
-    // NULL realloc (should act like malloc)
-    printf("  Calling sea_realloc(NULL, 50)...\n");
-    void *new_ptr = sea_realloc(NULL, 50);
-    printf("  sea_realloc(NULL, 50) returned: %p\n", new_ptr);
-    assert(new_ptr != NULL);
-    sea_free(new_ptr);
-
-    sea_free(ptr);
-
-    printf("  ✅ Realloc works!\n");
-}
-
-void test_calloc(void)
-{
-    printf("\n🔹 TEST 5: Calloc (zero-initialized)\n");
-
-    int *arr = sea_calloc(10, sizeof(int));
-    assert(arr != NULL);
-
-    int all_zero = 1;
-    for (int i = 0; i < 10; i++) {
-        if (arr[i] != 0) {
-            all_zero = 0;
-            break;
-        }
-    }
-
-    assert(all_zero);
-    printf("  ✅ Calloc zeros memory!\n");
-
-    sea_free(arr);
-}
-
-void test_fragmentation(void)
-{
-    printf("\n🔹 TEST 6: Fragmentation Test\n");
-
-    void *ptrs[100];
-
-    // Allocate 100 small blocks
-    for (int i = 0; i < 100; i++) {
-        ptrs[i] = sea_malloc(32);
-        assert(ptrs[i] != NULL);
-    }
-
-    // Free every other block (create holes)
-    for (int i = 0; i < 100; i += 2) {
-        sea_free(ptrs[i]);
-    }
-
-    // Allocate more (should reuse freed blocks)
-    for (int i = 0; i < 100; i += 2) {
-        ptrs[i] = sea_malloc(32);
-        assert(ptrs[i] != NULL);
-    }
-
-    // Free all
-    for (int i = 0; i < 100; i++) {
-        sea_free(ptrs[i]);
-    }
-
-    printf("  ✅ Fragmentation handled!\n");
-}
-
-void test_large_allocations(void)
-{
-    printf("\n🔹 TEST 7: Large Allocations\n");
-
-    void *huge1 = sea_malloc(1024 * 1024);      // 1 MB
-    void *huge2 = sea_malloc(1024 * 1024 * 5);  // 5 MB
-
-    assert(huge1 != NULL);
-    assert(huge2 != NULL);
-
-    printf("  1 MB allocation:  %p\n", huge1);
-    printf("  5 MB allocation:  %p\n", huge2);
-
-    memset(huge1, 0xFF, 1024 * 1024);
-    memset(huge2, 0xAA, 1024 * 1024 * 5);
-
-    assert(((unsigned char*)huge1)[0] == 0xFF);
-    assert(((unsigned char*)huge2)[0] == 0xAA);
-
-    sea_free(huge1);
-    sea_free(huge2);
-
-    printf("  ✅ Large allocations work!\n");
-}
-
-void test_stress(void)
-{
-    printf("\n🔹 TEST 8: Stress Test (%d allocations)\n", STRESS_TEST_COUNT);
-
-    void *ptrs[STRESS_TEST_COUNT];
-
-    for (int i = 0; i < STRESS_TEST_COUNT; i++) {
-        // Random sizes
-        size_t size = (i % 10) * 100 + 10;
-        ptrs[i] = sea_malloc(size);
-        assert(ptrs[i] != NULL);
-        memset(ptrs[i], i % 256, size);
-    }
-
-    // Free in reverse order
-    for (int i = STRESS_TEST_COUNT - 1; i >= 0; i--) {
-        sea_free(ptrs[i]);
-    }
-
-    printf("  ✅ Stress test passed!\n");
-}
-
-void test_original_demo(void)
-{
-    printf("\n🔹 TEST 10: Original Demo\n");
-
-    void *ptr[1024];
-
-    for (int i = 0; i < 20; i++)
-    {
-        if ((i % 2) == 0)
-            ptr[i] = sea_malloc(600);
-        else if ((i % 5) == 0)
-            ptr[i] = sea_malloc(5000);
-        else if ((i % 3) == 0)
-            ptr[i] = sea_malloc(200);
-        else if ((i % 8) == 0)
-            ptr[i] = sea_malloc(1000);
-        else if ((i % 7) == 0)
-            ptr[i] = sea_malloc(10000000);
-        else
-            ptr[i] = sea_malloc(50);
-    }
-
-    show_alloc_mem();
-
-    sea_printf("\n------------BONUS------------\n");
-    char *poof = "cocococococcococo1231232132132131ZAAAAAAAAAWAAAAAAAAAAAAAAAAAAAAAARUUUUUUUUUUUUUUUDOOOOOOOOOOOOOOO";
-    int len = sea_strlen(poof);
-    sea_memcpy_fast(ptr[3], (void *)poof, len);
-    show_alloc_mem_ex(ptr[3]);
-
-    for (int i = 0; i < 20; i++)
-        sea_free(ptr[i]);
-
-    printf("\n  ✅ Original demo passed!\n");
-}
-
-int main(void)
-{
-    printf("\n");
-    printf("🐙 ============================================== 🐙\n");
-    printf("       KRAKENLIB MALLOC COMPREHENSIVE TESTS\n");
-    printf("🐙 ============================================== 🐙\n");
-
-    test_basic_allocations();
-    test_zone_boundaries();
-    test_zero_and_null();
-    test_realloc();
-    test_calloc();
-    test_fragmentation();
-    test_large_allocations();
-    test_stress();
-    test_original_demo();
-
-    printf("\n");
-    printf("🐙 ============================================== 🐙\n");
-    printf("       🎉 ALL MALLOC TESTS PASSED! 🎉\n");
-    printf("       The Kraken's memory is UNLEASHED!\n");
-    printf("🐙 ============================================== 🐙\n");
-    printf("\n");
-
-    return 0;
-}
+/* ************************************************************************** */
+/*                                                                            */
+/*                        ______                                              */
+/*                     .-"      "-.                                           */
+/*                    /            \                                          */
+/*        _          |              |          _                              */
+/*       ( \         |,  .-.  .-.  ,|         / )                             */
+/*        > "=._     | )(__/  \__)( |     _.=" <                              */
+/*       (_/"=._"=._ |/     /\     \| _.="_.="\_)                             */
+/*              "=._ (_     ^^     _)"_.="                                    */
+/*                  "=\__|IIIIII|__/="                                        */
+/*                 _.="| \IIIIII/ |"=._                                       */
+/*       _     _.="_.="\          /"=._"=._     _                             */
+/*      ( \_.="_.="     `--------`     "=._"=._/ )                            */
+/*       > _.="                            "=._ <                             */
+/*      (_/                                    \_)                            */
+/*                                                                            */
+/*      Filename: test.c                                                      */
+/*      By: espadara <espadara@pirate.capn.gg>                                */
+/*      Created: 2025/11/11 22:41:16 by espadara                              */
+/*      Updated: 2026/10/17 21:56:53 by espadara                              */
+/*                                                                            */
+/* ************************************************************************** */
+#include "krakenlib.h"
+#include <stdio.h>
+
+#include "krakenlib.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <malloc.h>
+
+// glibc's allocator underneath, whatever malloc resolves to
+extern void *__libc_malloc(size_t size);
+extern void __libc_free(void *ptr);
+
+#define TEST_COUNT 50
+#define STRESS_TEST_COUNT 1000
+
+void test_basic_allocations(void)
+{
+    printf("\n🔹 TEST 1: Basic Allocations\n");
+
+    void *ptr1 = sea_malloc(10);
+    void *ptr2 = sea_malloc(100);
+    void *ptr3 = sea_malloc(1000);
+    void *ptr4 = sea_malloc(10000);
+
+    assert(ptr1 != NULL);
+    assert(ptr2 != NULL);
+    assert(ptr3 != NULL);
+    assert(ptr4 != NULL);
+
+    // Write to them
+    memset(ptr1, 'A', 10);
+    memset(ptr2, 'B', 100);
+    memset(ptr3, 'C', 1000);
+    memset(ptr4, 'D', 10000);
+
+    // Verify
+    assert(((char*)ptr1)[0] == 'A');
+    assert(((char*)ptr2)[0] == 'B');
+    assert(((char*)ptr3)[0] == 'C');
+    assert(((char*)ptr4)[0] == 'D');
+
+    sea_free(ptr1);
+    sea_free(ptr2);
+    sea_free(ptr3);
+    sea_free(ptr4);
+
+    printf("  ✅ Basic allocations work!\n");
+}
+
+void test_zone_boundaries(void)
+{
+    printf("\n🔹 TEST 2: Zone Boundaries\n");
+
+    // Test TINY zone boundary (64 bytes)
+    void *tiny_max = sea_malloc(64);
+    void *tiny_over = sea_malloc(65);
+
+    // Test SMALL zone boundary (1024 bytes)
+    void *small_max = sea_malloc(1024);
+    void *small_over = sea_malloc(1025);
+
+    assert(tiny_max != NULL);
+    assert(tiny_over != NULL);
+    assert(small_max != NULL);
+    assert(small_over != NULL);
+
+    printf("  TINY max (64):    %p\n", tiny_max);
+    printf("  TINY over (65):   %p\n", tiny_over);
+    printf("  SMALL max (1024): %p\n", small_max);
+    printf("  SMALL over (1025): %p\n", small_over);
+
+    sea_free(tiny_max);
+    sea_free(tiny_over);
+    sea_free(small_max);
+    sea_free(small_over);
+
+    printf("  ✅ Zone boundaries work!\n");
+}
+
+void test_zero_and_null(void)
+{
+    printf("\n🔹 TEST 3: Zero Size and NULL\n");
+
+    void *zero = sea_malloc(0);
+    printf("  sea_malloc(0) returned: %p\n", zero);
+
+    sea_free(NULL);  // Should not crash
+    printf("  sea_free(NULL) didn't crash\n");
+
+    sea_free(zero);
+
+    printf("  ✅ Edge cases handled!\n");
+}
+
+void test_realloc(void)
+{
+    printf("\n🔹 TEST 4: Realloc Tests\n");
+
+    char *ptr = sea_malloc(50);
+    printf("  sea_malloc(50) = %p\n", ptr);
+    assert(ptr != NULL);
+
+    strcpy(ptr, "Hello, Kraken!");
+    printf("  Original (50 bytes): '%s' at %p\n", ptr, ptr);
+
+    // Grow
+    printf("  Calling sea_realloc(%p, 100)...\n", ptr);
+    ptr = sea_realloc(ptr, 100);
+    printf("  sea_realloc(100) returned: %p\n", ptr);
+    assert(ptr != NULL);
+    assert(strcmp(ptr, "Hello, Kraken!") == 0);
+    printf("  After sea_realloc(100): '%s'\n", ptr);
+
+    // Shrink
+    printf("  Calling sea_realloc(%p, 20)...\n", ptr);
+    ptr = sea_realloc(ptr, 20);
+    printf("  sea_realloc(20) returned: %p\n", ptr);
+    assert(ptr != NULL);
+    printf("  After sea_realloc(20): '%s'\n", ptr);
+
+    // NULL realloc (should act like malloc)
+    printf("  Calling sea_realloc(NULL, 50)...\n");
+    void *new_ptr = sea_realloc(NULL, 50);
+    printf("  sea_realloc(NULL, 50) returned: %p\n", new_ptr);
+    assert(new_ptr != NULL);
+    sea_free(new_ptr);
+
+    sea_free(ptr);
+
+    printf("  ✅ Realloc works!\n");
+}
+
+void test_calloc(void)
+{
+    printf("\n🔹 TEST 5: Calloc (zero-initialized)\n");
+
+    int *arr = sea_calloc(10, sizeof(int));
+    assert(arr != NULL);
+
+    int all_zero = 1;
+    for (int i = 0; i < 10; i++) {
+        if (arr[i] != 0) {
+            all_zero = 0;
+            break;
+        }
+    }
+
+    assert(all_zero);
+    printf("  ✅ Calloc zeros memory!\n");
+
+    sea_free(arr);
+}
+
+void test_fragmentation(void)
+{
+    printf("\n🔹 TEST 6: Fragmentation Test\n");
+
+    void *ptrs[100];
+
+    // Allocate 100 small blocks
+    for (int i = 0; i < 100; i++) {
+        ptrs[i] = sea_malloc(32);
+        assert(ptrs[i] != NULL);
+    }
+
+    // Free every other block (create holes)
+    for (int i = 0; i < 100; i += 2) {
+        sea_free(ptrs[i]);
+    }
+
+    // Allocate more (should reuse freed blocks)
+    for (int i = 0; i < 100; i += 2) {
+        ptrs[i] = sea_malloc(32);
+        assert(ptrs[i] != NULL);
+    }
+
+    // Free all
+    for (int i = 0; i < 100; i++) {
+        sea_free(ptrs[i]);
+    }
+
+    printf("  ✅ Fragmentation handled!\n");
+}
+
+void test_large_allocations(void)
+{
+    printf("\n🔹 TEST 7: Large Allocations\n");
+
+    void *huge1 = sea_malloc(1024 * 1024);      // 1 MB
+    void *huge2 = sea_malloc(1024 * 1024 * 5);  // 5 MB
+
+    assert(huge1 != NULL);
+    assert(huge2 != NULL);
+
+    printf("  1 MB allocation:  %p\n", huge1);
+    printf("  5 MB allocation:  %p\n", huge2);
+
+    memset(huge1, 0xFF, 1024 * 1024);
+    memset(huge2, 0xAA, 1024 * 1024 * 5);
+
+    assert(((unsigned char*)huge1)[0] == 0xFF);
+    assert(((unsigned char*)huge2)[0] == 0xAA);
+
+    sea_free(huge1);
+    sea_free(huge2);
+
+    // Out of memory is a NULL, not a word on the host program's stdout
+    int fds[2];
+    char c;
+    assert(pipe(fds) == 0);
+    fflush(stdout);
+    int saved = dup(1);
+    dup2(fds[1], 1);
+    void *none = sea_malloc(1UL << 60);
+    dup2(saved, 1);
+    close(saved);
+    close(fds[1]);
+    assert(none == NULL);
+    assert(read(fds[0], &c, 1) == 0);
+    close(fds[0]);
+
+    printf("  ✅ Large allocations work!\n");
+}
+
+void test_stress(void)
+{
+    printf("\n🔹 TEST 8: Stress Test (%d allocations)\n", STRESS_TEST_COUNT);
+
+    void *ptrs[STRESS_TEST_COUNT];
+
+    for (int i = 0; i < STRESS_TEST_COUNT; i++) {
+        // Random sizes
+        size_t size = (i % 10) * 100 + 10;
+        ptrs[i] = sea_malloc(size);
+        assert(ptrs[i] != NULL);
+        memset(ptrs[i], i % 256, size);
+    }
+
+    // Free in reverse order
+    for (int i = STRESS_TEST_COUNT - 1; i >= 0; i--) {
+        sea_free(ptrs[i]);
+    }
+
+    printf("  ✅ Stress test passed!\n");
+}
+
+void test_original_demo(void)
+{
+    printf("\n🔹 TEST 10: Original Demo\n");
+
+    void *ptr[1024];
+
+    for (int i = 0; i < 20; i++)
+    {
+        if ((i % 2) == 0)
+            ptr[i] = sea_malloc(600);
+        else if ((i % 5) == 0)
+            ptr[i] = sea_malloc(5000);
+        else if ((i % 3) == 0)
+            ptr[i] = sea_malloc(200);
+        else if ((i % 8) == 0)
+            ptr[i] = sea_malloc(1000);
+        else if ((i % 7) == 0)
+            ptr[i] = sea_malloc(10000000);
+        else
+            ptr[i] = sea_malloc(50);
+    }
+
+    show_alloc_mem();
+
+    sea_printf("\n------------BONUS------------\n");
+    char *poof = "cocococococcococo1231232132132131ZAAAAAAAAAWAAAAAAAAAAAAAAAAAAAAAARUUUUUUUUUUUUUUUDOOOOOOOOOOOOOOO";
+    int len = sea_strlen(poof);
+    sea_memcpy_fast(ptr[3], (void *)poof, len);
+    show_alloc_mem_ex(ptr[3]);
+
+    for (int i = 0; i < 20; i++)
+        sea_free(ptr[i]);
+
+    printf("\n  ✅ Original demo passed!\n");
+}
+
+#define THREAD_COUNT 4
+#define THREAD_ROUNDS 20000
+
+static void *thread_worker(void *arg)
+{
+    size_t seed = (size_t)arg;
+    void *ptrs[64] = {0};
+
+    for (int i = 0; i < THREAD_ROUNDS; i++) {
+        int slot = (i * 7 + seed) % 64;
+        if (ptrs[slot]) {
+            assert(((unsigned char *)ptrs[slot])[0] == (unsigned char)slot);
+            sea_free(ptrs[slot]);
+        }
+        size_t size = ((i + seed) % 32) * 40 + 1;
+        ptrs[slot] = sea_malloc(size);
+        assert(ptrs[slot] != NULL);
+        memset(ptrs[slot], slot, size);
+    }
+    for (int i = 0; i < 64; i++)
+        sea_free(ptrs[i]);
+    return (NULL);
+}
+
+static void *thread_consumer(void *arg)
+{
+    void **ptrs = arg;
+
+    for (int i = 0; i < STRESS_TEST_COUNT; i++) {
+        assert(((int *)ptrs[i])[0] == i);
+        sea_free(ptrs[i]);
+    }
+    return (NULL);
+}
+
+void test_threads(void)
+{
+    printf("\n🔹 TEST 11: Threads (%d workers + cross-thread free)\n", THREAD_COUNT);
+
+    pthread_t threads[THREAD_COUNT];
+    static void *ptrs[STRESS_TEST_COUNT];
+
+    for (size_t i = 0; i < THREAD_COUNT; i++)
+        assert(pthread_create(&threads[i], NULL, thread_worker, (void *)i) == 0);
+    for (int i = 0; i < THREAD_COUNT; i++)
+        pthread_join(threads[i], NULL);
+
+    // Allocate here, free on another thread
+    for (int i = 0; i < STRESS_TEST_COUNT; i++) {
+        ptrs[i] = sea_malloc(16 + (i % 8) * 16);
+        assert(ptrs[i] != NULL);
+        ((int *)ptrs[i])[0] = i;
+    }
+    pthread_create(&threads[0], NULL, thread_consumer, ptrs);
+    pthread_join(threads[0], NULL);
+
+    printf("  ✅ Threaded allocations work!\n");
+}
+
+void test_large_realloc_and_foreign(void)
+{
+    printf("\n🔹 TEST 12: Large realloc & foreign pointers\n");
+
+    char *big = sea_malloc(20000);
+    assert(big != NULL);
+    for (int i = 0; i < 20000; i++)
+        big[i] = (char)(i % 251);
+    big = sea_realloc(big, 200000);
+    assert(big != NULL);
+    for (int i = 0; i < 20000; i++)
+        assert(big[i] == (char)(i % 251));
+
+    // Interior and foreign pointers are not ours: ignored, not crashed
+    int on_stack;
+    sea_free(&on_stack);
+    sea_free(big + 64);
+    assert(sea_realloc(&on_stack, 10) == NULL);
+    sea_free(big);
+
+    printf("  ✅ Large realloc and pointer lookup work!\n");
+}
+
+void test_medium(void)
+{
+    printf("\n🔹 TEST 13: Medium page runs (8KB - 512KB)\n");
+
+    size_t sizes[] = {8193, 9000, 16384, 40000, 100000, 300000, 512 * 1024};
+    int n = sizeof(sizes) / sizeof(sizes[0]);
+    void *ptrs[sizeof(sizes) / sizeof(sizes[0])];
+
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < n; i++) {
+            ptrs[i] = sea_malloc(sizes[i]);
+            assert(ptrs[i] != NULL);
+            assert(((uintptr_t)ptrs[i] & (PAGE_SIZE - 1)) == 0);
+            memset(ptrs[i], i + 1, sizes[i]);
+        }
+        for (int i = 0; i < n; i++)
+            assert(((unsigned char *)ptrs[i])[sizes[i] - 1] == i + 1);
+        // Free out of order so runs coalesce both ways
+        for (int i = 1; i < n; i += 2)
+            sea_free(ptrs[i]);
+        for (int i = 0; i < n; i += 2)
+            sea_free(ptrs[i]);
+    }
+
+    // Steady state: the same run comes back
+    void *a = sea_malloc(64 * 1024);
+    sea_free(a);
+    void *b = sea_malloc(64 * 1024);
+    assert(a == b);
+    b = sea_realloc(b, 400 * 1024);
+    assert(b != NULL);
+    sea_free(b);
+
+    // Per-page tags, not descriptors, in the chunk header
+    assert(MEDIUM_FIRST_PAGE <= 3);
+    // Chunks freed by a burst are there for the next one, until decay
+    static void *burst[64];
+    for (int i = 0; i < 64; i++)
+        burst[i] = sea_malloc(512 * 1024);
+    uint64_t chunks = __atomic_load_n(&g_stats.medium_chunks, __ATOMIC_RELAXED);
+    assert(chunks >= 64 / 7);
+    for (int i = 0; i < 64; i++)
+        sea_free(burst[i]);
+    for (int i = 0; i < 64; i++)
+        burst[i] = sea_malloc(512 * 1024);
+    assert(g_stats.medium_chunks == chunks);
+    for (int i = 0; i < 64; i++)
+        sea_free(burst[i]);
+    slab_decay(true);
+    assert(g_stats.medium_chunks == 0);
+
+    printf("  ✅ Medium allocations work!\n");
+}
+
+void test_size_classes(void)
+{
+    printf("\n🔹 TEST 14: Size classes & zone sizing\n");
+
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+        size_t zone = class_zone_size(i);
+        size_t blocks = (zone - sizeof(t_slab)) / class_to_size(i);
+        // The bitmap must reach (almost) every byte of the zone
+        assert(blocks <= SLAB_MAX_BLOCKS);
+        assert(zone - sizeof(t_slab) - blocks * class_to_size(i) < class_to_size(i));
+    }
+    for (size_t size = 1; size <= SMALL_BLOCK_MAX; size += 7) {
+        void *ptr = sea_malloc(size);
+        t_slab *slab = find_slab_by_ptr(ptr, NULL);
+        assert(slab != NULL);
+        assert(slab->block_size >= size);
+        assert(slab->block_size - size < slab->block_size / 4 + MIN_ALIGNMENT);
+        sea_free(ptr);
+    }
+
+    printf("  ✅ Size classes are right-sized!\n");
+}
+
+// TINY/SMALL frees are deferred on the remote lists: apply them now
+static void reclaim_remote(void)
+{
+    remote_free_reclaim_all();
+}
+
+void test_partial_full_lists(void)
+{
+    printf("\n🔹 TEST 15: Partial / full slab lists\n");
+
+    static void *ptrs[1600];
+    int class_idx = size_to_class(2000);
+    int full = 0;
+
+    for (int i = 0; i < 1600; i++) {
+        ptrs[i] = sea_malloc(2000);
+        assert(ptrs[i] != NULL);
+    }
+    for (t_slab *slab = g_heap.small_full[class_idx]; slab; slab = slab->next) {
+        assert(slab->free_count == 0);
+        full++;
+    }
+    assert(full >= 3);
+    for (t_slab *slab = g_heap.small[class_idx]; slab; slab = slab->next)
+        assert(slab->free_count > 0);
+
+    // A hole in the oldest full slab makes it the first candidate
+    sea_free(ptrs[10]);
+    reclaim_remote();
+    assert(g_heap.small[class_idx] == find_slab_by_ptr(ptrs[10], NULL));
+    assert(sea_malloc(2000) == ptrs[10]);
+
+    for (int i = 0; i < 1600; i++)
+        sea_free(ptrs[i]);
+
+    printf("  ✅ Full slabs are never scanned!\n");
+}
+
+void test_empty_slab_retention(void)
+{
+    printf("\n🔹 TEST 16: Empty slab retention & decay\n");
+
+    int class_idx = size_to_class(6000);
+    void *a = sea_malloc(6000);
+    t_slab *slab = find_slab_by_ptr(a, NULL);
+
+    assert(slab != NULL);
+    sea_free(a);
+    reclaim_remote();
+    // The zone is parked, not unmapped, and comes straight back
+    assert(g_heap.empty[class_idx] == slab);
+    void *b = sea_malloc(6000);
+    assert(find_slab_by_ptr(b, NULL) == slab);
+    assert(g_heap.empty_count[class_idx] == 0);
+    sea_free(b);
+    reclaim_remote();
+    assert(g_heap.empty_count[class_idx] == 1);
+
+    // Forced decay drops every retained zone
+    slab_decay(true);
+    assert(g_heap.empty[class_idx] == NULL);
+    assert(find_slab_by_ptr(b, NULL) == NULL);
+
+    printf("  ✅ Empty slabs are retained and decayed!\n");
+}
+
+void test_large_cache(void)
+{
+    printf("\n🔹 TEST 17: LARGE cache (best fit, byte budget)\n");
+
+    // Start from an empty cache
+    slab_decay(true);
+    assert(g_heap.cache_bytes == 0);
+
+    void *small = sea_malloc(1024 * 1024);
+    void *big = sea_malloc(8 * 1024 * 1024);
+    sea_free(small);
+    sea_free(big);
+
+    // 600KB must not be served from the 8MB mapping
+    void *hit = sea_malloc(600 * 1024);
+    assert(hit == small);
+    sea_free(hit);
+
+    // Oversized hit is split: head served, tail stays cached
+    void *part = sea_malloc(2 * 1024 * 1024);
+    assert(part == big);
+    assert(g_heap.cache_bytes >= 5 * 1024 * 1024);
+    sea_free(part);
+
+    // The budget holds whatever we throw at it
+    void *ptrs[10];
+    for (int i = 0; i < 10; i++)
+        ptrs[i] = sea_malloc(20 * 1024 * 1024 + i * PAGE_SIZE);
+    for (int i = 0; i < 10; i++)
+        sea_free(ptrs[i]);
+    assert(g_heap.cache_bytes <= LARGE_CACHE_BYTES);
+
+    printf("  ✅ LARGE cache is best-fit and bounded!\n");
+}
+
+void test_large_realloc_in_place(void)
+{
+    printf("\n🔹 TEST 18: LARGE realloc through mremap\n");
+
+    size_t size = 600000;
+    unsigned char *ptr = sea_malloc(size);
+    for (size_t i = 0; i < size; i++)
+        ptr[i] = (unsigned char)(i * 31);
+
+    // Growth inside the page-rounded slack keeps the pointer
+    unsigned char *same = sea_realloc(ptr, size + 1000);
+    assert(same == ptr);
+
+    // Growth by doubling: contents survive every remap
+    for (int round = 0; round < 6; round++) {
+        size_t new_size = size * 2;
+        ptr = sea_realloc(ptr, new_size);
+        assert(ptr != NULL);
+        memset(ptr + size, 0x5A, new_size - size);
+        size = new_size;
+    }
+    for (size_t i = 0; i < 600000; i++)
+        assert(ptr[i] == (unsigned char)(i * 31));
+
+    // Shrink returns the tail and keeps the head
+    ptr = sea_realloc(ptr, 700000);
+    assert(ptr != NULL);
+    assert(find_slab_by_ptr(ptr, NULL)->block_size == 700000);
+    for (size_t i = 0; i < 600000; i++)
+        assert(ptr[i] == (unsigned char)(i * 31));
+    sea_free(ptr);
+
+    printf("  ✅ LARGE realloc never copies!\n");
+}
+
+void test_usable_size_and_aligned(void)
+{
+    printf("\n🔹 TEST 19: usable size and aligned blocks (preload support)\n");
+
+    // usable size is the class / run / mapping, never less than asked
+    size_t sizes[] = {1, 100, 1000, 9000, 100000, 600000};
+    for (int i = 0; i < 6; i++) {
+        char *ptr = sea_malloc(sizes[i]);
+        size_t usable = sea_malloc_usable_size(ptr);
+        assert(usable >= sizes[i]);
+        memset(ptr, 0x42, usable);
+        sea_free(ptr);
+    }
+    int local;
+    assert(sea_malloc_usable_size(&local) == 0);
+    assert(sea_malloc_usable_size(NULL) == 0);
+
+    // Under test-preload, glibc's blocks keep glibc's answer (a sanitizer
+    // runtime would answer for its own heap instead)
+    if (getenv("LD_PRELOAD"))
+    {
+        void *libc_block = __libc_malloc(100);
+        assert(malloc_usable_size(libc_block) >= 100);
+        __libc_free(libc_block);
+    }
+
+    // Bytes past the requested MEDIUM size survive a realloc move
+    unsigned char *run = sea_malloc(9000);
+    size_t usable = sea_malloc_usable_size(run);
+    run[usable - 1] = 0xAB;
+    run = sea_realloc(run, usable + 1);
+    assert(run[usable - 1] == 0xAB);
+    sea_free(run);
+
+    // Every alignment, small to huge
+    for (size_t align = 8; align <= (1UL << 21); align <<= 1) {
+        size_t req[] = {1, 5000, 700000};
+        for (int i = 0; i < 3; i++) {
+            char *ptr = sea_aligned_alloc(align, req[i]);
+            assert(ptr != NULL);
+            assert(((uintptr_t)ptr & (align - 1)) == 0);
+            assert(sea_malloc_usable_size(ptr) >= req[i]);
+            memset(ptr, 0x5A, req[i]);
+            // aligned LARGE blocks still grow and shrink
+            if (req[i] == 700000) {
+                ptr = sea_realloc(ptr, 3000000);
+                assert(ptr != NULL && ptr[699999] == 0x5A);
+                ptr = sea_realloc(ptr, 800000);
+                assert(ptr != NULL && ptr[0] == 0x5A);
+            }
+            sea_free(ptr);
+        }
+    }
+
+    printf("  ✅ Usable size and alignment hold!\n");
+}
+
+void test_slab_alignment(void)
+{
+    printf("\n🔹 TEST 20: slab block alignment and aligned classes\n");
+
+    // Every slab block is 16 aligned, and aligned to its class size's
+    // lowest set bit up to a page
+    for (int c = 0; c < NUM_SIZE_CLASSES; c++) {
+        size_t size = class_to_size(c);
+        void *ptrs[8];
+        for (int i = 0; i < 8; i++) {
+            ptrs[i] = sea_malloc(size);
+            assert(((uintptr_t)ptrs[i] % MIN_ALIGNMENT) == 0);
+            assert(((uintptr_t)ptrs[i] % class_align(size)) == 0);
+        }
+        for (int i = 0; i < 8; i++)
+            sea_free(ptrs[i]);
+    }
+
+    // 64 B .. 4 KB alignments come straight from slabs, no padding
+    for (size_t align = 64; align <= PAGE_SIZE; align <<= 1) {
+        size_t req[] = {1, 40, 100, 700, 3000};
+        for (int i = 0; i < 5; i++) {
+            void *ptr = sea_aligned_alloc(align, req[i]);
+            int type = -1;
+            assert(ptr != NULL);
+            assert(((uintptr_t)ptr & (align - 1)) == 0);
+            assert(find_slab_by_ptr(ptr, &type) != NULL && type < 2);
+            size_t want = req[i] < align ? align : req[i];
+            assert(sea_malloc_usable_size(ptr) < 2 * want + align);
+            sea_free(ptr);
+        }
+    }
+    // cache line aligned 64 B blocks are exactly 64 B
+    void *line = sea_aligned_alloc(64, 64);
+    assert(sea_malloc_usable_size(line) == 64);
+    sea_free(line);
+
+    // legacy memalign rounds a bad alignment up, aligned_alloc refuses it
+    void *odd = sea_memalign(48, 10);
+    assert(odd != NULL && ((uintptr_t)odd & 63) == 0);
+    sea_free(odd);
+    assert(sea_aligned_alloc(48, 10) == NULL);
+    assert(sea_aligned_alloc(0, 10) == NULL);
+
+    printf("  ✅ Slab blocks honour their alignment!\n");
+}
+
+#define PIPE_DEPTH 4096
+
+static void *pipe_consumer(void *arg)
+{
+    void **ptrs = arg;
+
+    // 2000 B blocks skip the thread cache: every free is a remote push
+    for (int i = 0; i < PIPE_DEPTH; i++) {
+        assert(((int *)ptrs[i])[0] == i);
+        sea_free(ptrs[i]);
+    }
+    return (NULL);
+}
+
+void test_remote_free(void)
+{
+    printf("\n🔹 TEST 21: Lock-free remote frees\n");
+
+    static void *ptrs[PIPE_DEPTH];
+    int class_idx = size_to_class(2000);
+    pthread_t consumer;
+
+    reclaim_remote();
+    for (int i = 0; i < PIPE_DEPTH; i++) {
+        ptrs[i] = sea_malloc(2000);
+        ((int *)ptrs[i])[0] = i;
+    }
+    // The consumer frees while we hold the class lock: it must not wait
+    pthread_mutex_lock(&g_class_lock[class_idx].mutex);
+    pthread_create(&consumer, NULL, pipe_consumer, ptrs);
+    pthread_join(consumer, NULL);
+    assert(__atomic_load_n(&g_heap.remote[class_idx].head, __ATOMIC_ACQUIRE) != NULL);
+    assert(g_heap.remote[class_idx].count == PIPE_DEPTH);
+    pthread_mutex_unlock(&g_class_lock[class_idx].mutex);
+
+    // The next allocation reclaims the list in bulk and reuses its blocks
+    void *again = sea_malloc(2000);
+    bool reused = false;
+    for (int i = 0; i < PIPE_DEPTH; i++)
+        reused |= (again == ptrs[i]);
+    assert(reused);
+    assert(g_heap.remote[class_idx].head == NULL);
+    assert(g_heap.remote[class_idx].count == 0);
+    sea_free(again);
+
+    // With the lock free, pushes apply the list themselves past
+    // REMOTE_APPLY: zones emptied remotely are seen as empty right away
+    reclaim_remote();
+    for (int i = 0; i < PIPE_DEPTH; i++) {
+        ptrs[i] = sea_malloc(2000);
+        ((int *)ptrs[i])[0] = i;
+    }
+    pthread_create(&consumer, NULL, pipe_consumer, ptrs);
+    pthread_join(consumer, NULL);
+    assert(g_heap.remote[class_idx].count < REMOTE_APPLY);
+    assert(g_heap.empty_count[class_idx] > 0);
+
+    // Many producers, many consumers, tcache batches pushed as chains
+    for (int round = 0; round < 4; round++) {
+        pthread_t threads[4];
+        static void *lists[4][PIPE_DEPTH];
+        for (int t = 0; t < 4; t++)
+            for (int i = 0; i < PIPE_DEPTH; i++) {
+                lists[t][i] = sea_malloc((i % 3) ? 48 : 2000);
+                ((int *)lists[t][i])[0] = i;
+            }
+        for (int t = 0; t < 4; t++)
+            pthread_create(&threads[t], NULL, pipe_consumer, lists[t]);
+        for (int t = 0; t < 4; t++)
+            pthread_join(threads[t], NULL);
+    }
+    reclaim_remote();
+    for (int c = 0; c < NUM_SIZE_CLASSES; c++)
+        assert(g_heap.remote[c].head == NULL && g_heap.remote[c].count == 0);
+
+    printf("  ✅ Cross-thread frees never take the lock!\n");
+}
+
+static void *other_tiers(void *arg)
+{
+    (void)arg;
+    // SMALL (past the tcache), MEDIUM and LARGE, all while TINY is locked
+    for (int i = 0; i < 100; i++) {
+        void *s = sea_malloc(3000);
+        void *m = sea_malloc(100000);
+        void *l = sea_malloc(1024 * 1024);
+        assert(s && m && l);
+        l = sea_realloc(l, 3 * 1024 * 1024);
+        sea_free(s);
+        sea_free(m);
+        sea_free(l);
+    }
+    return (NULL);
+}
+
+void test_per_class_locks(void)
+{
+    printf("\n🔹 TEST 22: Per-class locks\n");
+
+    // Holding one class lock must not stall any other class or tier
+    int tiny = size_to_class(48);
+    pthread_t thread;
+    // with a decay pass due: it must step over the busy class
+    g_heap.decay_stamp -= SLAB_DECAY_MS;
+    pthread_mutex_lock(&g_class_lock[tiny].mutex);
+    pthread_create(&thread, NULL, other_tiers, NULL);
+    pthread_join(thread, NULL);
+    pthread_mutex_unlock(&g_class_lock[tiny].mutex);
+
+    // Locks never share a cache line
+    assert(sizeof(t_lock) % 64 == 0);
+    assert(((uintptr_t)&g_class_lock[1] & 63) == 0);
+
+    // Every class at once from many threads
+    pthread_t threads[8];
+    for (int t = 0; t < 8; t++)
+        pthread_create(&threads[t], NULL, thread_worker, (void *)(size_t)(t * 5));
+    for (int t = 0; t < 8; t++)
+        pthread_join(threads[t], NULL);
+
+    printf("  ✅ Unrelated classes allocate in parallel!\n");
+}
+
+void test_sized_and_batch(void)
+{
+    printf("\n🔹 TEST 23: Sized free and batch alloc/free\n");
+
+    // Sized free: same block comes back for the same size
+    void *a = sea_malloc(40);
+    sea_free_sized(a, 40);
+    assert(sea_malloc(40) == a);
+    sea_free_sized(a, 40);
+    void *big = sea_malloc(3000);
+    sea_free_sized(big, 3000);
+    void *medium = sea_malloc(50000);
+    sea_free_sized(medium, 50000);
+
+    // A shrink that changes class moves, so the new size stays exact
+    char *moved = sea_malloc(1000);
+    memset(moved, 'k', 1000);
+    char *small = sea_realloc(moved, 20);
+    assert(small != moved && memcmp(small, "kkkkkkkkkkkkkkkkkkkk", 20) == 0);
+    assert(find_slab_by_ptr(small, NULL)->class_idx == size_to_class(20));
+    sea_free_sized(small, 20);
+    char *shrunk = sea_realloc(sea_malloc(2 * 1024 * 1024), 100);
+    assert(find_slab_by_ptr(shrunk, NULL)->type == 0);
+    sea_free_sized(shrunk, 100);
+
+    // Batch of TINY nodes: all distinct, writable, from as few slabs as possible
+    static void *nodes[3000];
+    size_t n = sea_malloc_batch(48, 3000, nodes);
+    assert(n == 3000);
+    for (size_t i = 0; i < n; i++) {
+        assert(((uintptr_t)nodes[i] & 15) == 0);
+        memset(nodes[i], (int)i, 48);
+    }
+    for (size_t i = 0; i < n; i++)
+        assert(((unsigned char *)nodes[i])[47] == (unsigned char)i);
+    assert(g_heap.tiny_full[size_to_class(48)] != NULL);
+    // straight to the bitmaps: no slab of the class is left full
+    sea_free_batch(nodes, n);
+    assert(g_heap.tiny_full[size_to_class(48)] == NULL);
+
+    // Mixed tiers, NULLs and foreign pointers in one batch
+    void *mixed[6];
+    int local;
+    assert(sea_malloc_batch(100000, 2, mixed) == 2);
+    assert(sea_malloc_batch(1024 * 1024, 2, mixed + 2) == 2);
+    mixed[4] = NULL;
+    mixed[5] = &local;
+    sea_free_batch(mixed, 6);
+    assert(find_slab_by_ptr(mixed[0], NULL) == NULL);
+    assert(find_slab_by_ptr(mixed[2], NULL) == NULL);
+    assert(sea_malloc_batch(0, 5, mixed) == 0);
+
+    printf("  ✅ Bulk work pays the lock once!\n");
+}
+
+static size_t resident_pages(void *ptr, size_t len)
+{
+    static unsigned char vec[32 * 1024];
+    char *base = (char *)((uintptr_t)ptr & ~(uintptr_t)(PAGE_SIZE - 1));
+    size_t pages = (len + PAGE_SIZE - 1) / PAGE_SIZE;
+    size_t count = 0;
+
+    assert(pages <= sizeof(vec));
+    if (mincore(base, pages * PAGE_SIZE, vec) != 0)
+        return (pages);
+    for (size_t i = 0; i < pages; i++)
+        count += vec[i] & 1;
+    return (count);
+}
+
+static int all_zero(const unsigned char *p, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        if (p[i])
+            return (0);
+    return (1);
+}
+
+void test_zero_aware_calloc(void)
+{
+    printf("\n🔹 TEST 24: Zero-aware calloc\n");
+
+    // 100 MB of fresh mapping: nothing gets touched
+    unsigned char *huge = sea_calloc(100, 1024 * 1024);
+    assert(huge != NULL);
+    assert(resident_pages(huge, 100 * 1024 * 1024) < 16);
+    assert(huge[0] == 0 && huge[50 * 1024 * 1024] == 0
+           && huge[100 * 1024 * 1024 - 1] == 0);
+    sea_free(huge);
+
+    // Recycled memory of every tier comes back cleared
+    size_t sizes[] = {40, 3000, 100000, 2 * 1024 * 1024};
+    for (int i = 0; i < 4; i++) {
+        unsigned char *dirty = sea_malloc(sizes[i]);
+        memset(dirty, 0xFF, sizes[i]);
+        sea_free(dirty);
+        unsigned char *clean = sea_calloc(1, sizes[i]);
+        assert(clean != NULL && all_zero(clean, sizes[i]));
+        memset(clean, 0xEE, sizes[i]);
+        sea_free(clean);
+    }
+    // A MEDIUM run half over used pages, half over fresh ones
+    unsigned char *head = sea_malloc(60000);
+    memset(head, 0xFF, 60000);
+    sea_free(head);
+    unsigned char *wide = sea_calloc(1, 400000);
+    assert(all_zero(wide, 400000));
+    sea_free(wide);
+
+    // Slab blocks past the high-water mark, and reused ones below it
+    static unsigned char *blocks[300];
+    for (int i = 0; i < 300; i++) {
+        blocks[i] = sea_calloc(1, 5000);
+        assert(all_zero(blocks[i], 5000));
+        memset(blocks[i], 0x77, 5000);
+    }
+    for (int i = 0; i < 300; i += 2)
+        sea_free(blocks[i]);
+    for (int i = 0; i < 300; i += 2) {
+        blocks[i] = sea_calloc(5000, 1);
+        assert(all_zero(blocks[i], 5000));
+    }
+    for (int i = 0; i < 300; i++)
+        sea_free(blocks[i]);
+
+    printf("  ✅ calloc only clears what may be dirty!\n");
+}
+
+static void *stats_producer(void *arg)
+{
+    void **ptrs = arg;
+
+    for (int i = 0; i < 100; i++)
+        ptrs[i] = sea_malloc(40);
+    return (NULL);
+}
+
+void test_stats(void)
+{
+    printf("\n🔹 TEST 25: Allocator statistics\n");
+
+    static t_malloc_stats before;
+    static t_malloc_stats after;
+    int c = size_to_class(40);
+    void *ptrs[100];
+
+    // Counted on a thread that is gone by the snapshot, freed on this one
+    sea_malloc_stats(&before);
+    pthread_t thread;
+    pthread_create(&thread, NULL, stats_producer, ptrs);
+    pthread_join(thread, NULL);
+    for (int i = 0; i < 60; i++)
+        sea_free(ptrs[i]);
+    sea_malloc_stats(&after);
+    assert(after.classes[c].block_size == 48);
+    assert(after.classes[c].nmalloc - before.classes[c].nmalloc == 100);
+    assert(after.classes[c].nfree - before.classes[c].nfree == 60);
+    assert(after.classes[c].live - before.classes[c].live == 40);
+    assert(after.classes[c].spans > 0);
+    assert(after.classes[c].allocated <= after.classes[c].mapped);
+    sea_free_batch(ptrs + 60, 40);
+
+    // Zones mapped before and after small_zone moves each count their own size
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int s = size_to_class(3000);
+        void *blocks[600];
+        void *old_zone = sea_malloc(3000);
+        sea_malloc_trim(0);
+        sea_malloc_stats(&before);
+        setenv("KRAKEN_MALLOC_CONF", "small_zone:256k", 1);
+        g_conf.ready = 0;
+        g_conf.booting = 0;
+        conf_init();
+        for (int i = 0; i < 600; i++)
+            blocks[i] = sea_malloc(3000);
+        sea_malloc_stats(&after);
+        int ok = before.classes[s].mapped >= SMALL_ZONE_SIZE
+            && after.classes[s].spans > before.classes[s].spans
+            && after.classes[s].mapped - before.classes[s].mapped
+               == (after.classes[s].spans - before.classes[s].spans) * 256 * 1024;
+        sea_free_batch(blocks, 600);
+        sea_free(old_zone);
+        _exit(ok ? 0 : 1);
+    }
+    int status;
+    assert(pid > 0 && waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // MEDIUM and LARGE, and a mapping too big to ever be cached
+    sea_malloc_stats(&before);
+    void *m = sea_malloc(100000);
+    void *l = sea_malloc(40 * 1024 * 1024);
+    sea_malloc_stats(&after);
+    assert(after.medium.nmalloc - before.medium.nmalloc == 1);
+    assert(after.medium.allocated - before.medium.allocated == 25 * PAGE_SIZE);
+    assert(after.large.live - before.large.live == 1);
+    assert(after.large.allocated - before.large.allocated >= 40 * 1024 * 1024);
+    assert(after.mmap_calls > before.mmap_calls);
+    assert(after.mapped - before.mapped >= 40 * 1024 * 1024);
+    sea_free(m);
+    sea_free(l);
+    sea_malloc_stats(&before);
+    assert(before.medium.nfree - after.medium.nfree == 1);
+    assert(before.large.nfree - after.large.nfree == 1);
+    assert(before.munmap_calls > after.munmap_calls);
+    assert(after.mapped - before.mapped >= 40 * 1024 * 1024);
+
+    // Ratios stay ratios
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++)
+        assert(before.classes[i].fragmentation >= 0.0
+               && before.classes[i].fragmentation <= 1.0);
+    assert(before.allocated <= before.mapped);
+    assert(before.fragmentation >= 0.0 && before.fragmentation <= 1.0);
+
+    printf("  ✅ Counters add up without walking the heap!\n");
+}
+
+__attribute__((noinline))
+static void *profiled_site(size_t size)
+{
+    return (sea_malloc(size));
+}
+
+// Dump the profile into buf, return its "heap profile:" live count
+static long prof_snapshot(char *buf, size_t len)
+{
+    FILE *f = tmpfile();
+    assert(f != NULL);
+    assert(sea_malloc_prof_dump(fileno(f)));
+    rewind(f);
+    size_t n = fread(buf, 1, len - 1, f);
+    buf[n] = '\0';
+    fclose(f);
+    assert(strncmp(buf, "heap profile: ", 14) == 0);
+    assert(strstr(buf, "@ heap_v2/4096\n") != NULL);
+    assert(strstr(buf, "\nMAPPED_LIBRARIES:\n") != NULL);
+    return (atol(buf + 14));
+}
+
+void test_heap_profiler(void)
+{
+    printf("\n🔹 TEST 26: Sampling heap profiler\n");
+
+    static char buf[1 << 20];
+    static void *ptrs[2000];
+
+    // ~1 MB of 500 B blocks at one site, a sample every ~4 KB
+    sea_malloc_prof_start(4096);
+    for (int i = 0; i < 2000; i++)
+        ptrs[i] = profiled_site(500);
+    void *big = profiled_site(2 * 1024 * 1024);
+    long live = prof_snapshot(buf, sizeof(buf));
+    long bytes = 0;
+    assert(live > 100 && live < 2000);
+    // 2 MB is 500 intervals long: it can't miss its sample
+    assert(sscanf(buf, "heap profile: %*d: %ld", &bytes) == 1);
+    assert(bytes >= 2 * 1024 * 1024);
+    char *line = strchr(buf, '\n') + 1;
+    assert(strstr(line, "] @ 0x") != NULL);
+
+    // Freed samples leave the live count, not the totals
+    for (int i = 0; i < 2000; i++)
+        sea_free(ptrs[i]);
+    big = sea_realloc(big, 8 * 1024 * 1024);
+    sea_free(big);
+    assert(prof_snapshot(buf, sizeof(buf)) == 0);
+    assert(strstr(buf, " [0: ") == NULL);
+    assert(g_prof.nsamples == 0);
+
+    // A batch skips pointers that aren't blocks (inside one, or in the zone
+    // header) and the sampled block keeps its sample
+    int n = 0;
+    while (g_prof.nsamples == 0)
+        ptrs[n++] = profiled_site(500);
+    t_slab *zone = pagemap_get(ptrs[n - 1]);
+    void *bad[2] = {(char *)ptrs[n - 1] + 16,
+                    slab_data(zone) - zone->block_size};
+    assert(zone->data_offset >= zone->block_size);
+    sea_free_batch(bad, 2);
+    assert(g_prof.nsamples == 1);
+    sea_free_batch(ptrs, n);
+    assert(g_prof.nsamples == 0);
+
+    // Stopped: nothing new gets sampled
+    sea_malloc_prof_stop();
+    for (int i = 0; i < 2000; i++)
+        ptrs[i] = profiled_site(500);
+    assert(g_prof.nsamples == 0);
+    for (int i = 0; i < 2000; i++)
+        sea_free(ptrs[i]);
+
+    // 2 MB zones: blocks past the first MB don't fit a header lane
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        setenv("KRAKEN_MALLOC_CONF", "small_zone:2m", 1);
+        g_conf.ready = 0;
+        g_conf.booting = 0;
+        conf_init();
+        int keep = -1;
+        for (int i = 0; i < 600; i++) {
+            ptrs[i] = sea_malloc(8192);
+            t_slab *slab = pagemap_get(ptrs[i]);
+            if (keep < 0 && slab->zone_pages * PAGE_SIZE == 2 * 1024 * 1024
+                && (char *)ptrs[i] - (char *)slab > 1024 * 1024)
+                keep = i;
+        }
+        assert(keep >= 0);
+        // sampled again into a zone whose lanes are all free
+        t_slab *slab = pagemap_get(ptrs[keep]);
+        sea_free(ptrs[keep]);
+        sea_malloc_prof_start(64);
+        sea_free(sea_malloc(2 * 1024 * 1024)); // picks the rate up
+        void *p = sea_malloc(8192);
+        int ok = p == ptrs[keep] && g_prof.nsamples == 1;
+        sea_free(p);
+        ok = ok && g_prof.nsamples == 0
+            && slab->sampled_at == 0 && slab->sampled_more == 0;
+        for (int i = 0; i < 600; i++)
+            if (i != keep)
+                sea_free(ptrs[i]);
+        _exit(ok ? 0 : 1);
+    }
+    int status;
+    assert(pid > 0 && waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    printf("  ✅ Sampled sites come and go with their blocks!\n");
+}
+
+static void *trace_worker(void *arg)
+{
+    // enough to fill the thread's ring twice over
+    for (int i = 0; i < TRACE_RING_EVENTS; i++)
+        sea_free(sea_malloc(24));
+    return (arg);
+}
+
+void test_allocation_trace(void)
+{
+    printf("\n🔹 TEST 27: Allocation trace\n");
+
+    char path[] = "/tmp/kraken_trace_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    assert(sea_malloc_trace_start(path));
+    assert(!sea_malloc_trace_start(path));
+    void *a = sea_malloc(100);
+    void *b = sea_calloc(10, 10);
+    void *a2 = sea_realloc(a, 5000);
+    void *c = sea_aligned_alloc(64, 200);
+    sea_free(a2);
+    sea_free_sized(b, 100);
+    sea_free(c);
+    sea_free(NULL);
+    pthread_t worker;
+    assert(pthread_create(&worker, NULL, trace_worker, NULL) == 0);
+    pthread_join(worker, NULL);
+    sea_malloc_trace_stop();
+    sea_free(sea_malloc(100)); // not traced any more
+
+    FILE *f = fopen(path, "rb");
+    t_trace_header hdr;
+    t_trace_event ev;
+    assert(f && fread(&hdr, sizeof(hdr), 1, f) == 1);
+    assert(memcmp(hdr.magic, TRACE_MAGIC, 8) == 0);
+    assert(hdr.version == TRACE_VERSION && hdr.event_size == sizeof(ev));
+
+    // The main thread's 7 calls in order, the worker's as malloc/free pairs
+    uint32_t want[] = {TRACE_MALLOC, TRACE_CALLOC, TRACE_REALLOC,
+                       TRACE_ALIGNED, TRACE_FREE, TRACE_FREE, TRACE_FREE};
+    uintptr_t ptrs[] = {(uintptr_t)a, (uintptr_t)b, (uintptr_t)a2,
+                        (uintptr_t)c, (uintptr_t)a2, (uintptr_t)b, (uintptr_t)c};
+    uint64_t last[2] = {0, 0};
+    uint64_t live = 0;
+    int mine = 0;
+    int theirs = 0;
+    uint32_t main_id = UINT32_MAX;
+    while (fread(&ev, sizeof(ev), 1, f) == 1) {
+        if (main_id == UINT32_MAX && ev.op == TRACE_MALLOC && ev.size == 100)
+            main_id = ev.thread;
+        int t = ev.thread != main_id;
+        assert(ev.ns >= last[t]);
+        last[t] = ev.ns;
+        if (!t) {
+            assert(mine < 7);
+            assert(ev.op == want[mine] && ev.ptr == ptrs[mine]);
+            if (ev.op == TRACE_REALLOC)
+                assert(ev.old == (uintptr_t)a && ev.size == 5000);
+            if (ev.op == TRACE_CALLOC)
+                assert(ev.size == 100);
+            if (ev.op == TRACE_ALIGNED)
+                assert(ev.old == 64 && ev.size == 200);
+            mine++;
+            continue;
+        }
+        assert(ev.op == (theirs % 2 ? TRACE_FREE : TRACE_MALLOC));
+        if (ev.op == TRACE_MALLOC)
+            live = ev.ptr;
+        else
+            assert(ev.ptr == live);
+        theirs++;
+    }
+    assert(mine == 7);
+    assert(theirs == 2 * TRACE_RING_EVENTS);
+    fclose(f);
+    unlink(path);
+
+    printf("  ✅ Every call lands in the trace, in order!\n");
+}
+
+static void *heap_worker(void *arg)
+{
+    t_sea_heap *heap = arg;
+    void *ptrs[500];
+
+    for (int round = 0; round < 20; round++)
+    {
+        for (int i = 0; i < 500; i++)
+            ptrs[i] = sea_heap_alloc(heap, 16 + (i * 37) % 3000);
+        for (int i = 0; i < 500; i += 2)
+            sea_free(ptrs[i]);
+    }
+    return (NULL);
+}
+
+void test_explicit_heaps(void)
+{
+    printf("\n🔹 TEST 28: Explicit heaps\n");
+
+    static t_malloc_stats before;
+    static t_malloc_stats after;
+    static void *ptrs[3000];
+    static size_t sizes[3000];
+    int type;
+
+    sea_malloc_stats(&before);
+    t_sea_heap *a = sea_heap_create();
+    t_sea_heap *b = sea_heap_create();
+    assert(a && b && a->id != b->id);
+
+    // Mixed sizes, all of them in the heap's own slabs / mappings
+    for (int i = 0; i < 3000; i++)
+    {
+        sizes[i] = 1 + (size_t)(i * 7919) % (i % 50 ? 4000 : 100000);
+        ptrs[i] = sea_heap_alloc(i % 3 ? a : b, sizes[i]);
+        assert(ptrs[i]);
+        memset(ptrs[i], i & 0xff, sizes[i]);
+        t_slab *slab = find_slab_by_ptr(ptrs[i], &type);
+        assert(slab->heap_id == (i % 3 ? a : b)->id);
+        assert(type == (sizes[i] > SMALL_BLOCK_MAX ? 3 : sizes[i] > TINY_BLOCK_MAX));
+    }
+
+    // Freed one by one (plain, sized, batched): back to the heap, not a cache
+    for (int i = 0; i < 3000; i += 4)
+        sea_free(ptrs[i]);
+    for (int i = 1; i < 3000; i += 8)
+        sea_free_sized(ptrs[i], sizes[i]);
+    for (int i = 0; i < 3000; i += 4)
+        ptrs[i] = sea_heap_alloc(i % 3 ? a : b, sizes[i]);
+    for (int i = 0; i < 3000; i += 4)
+        assert(find_slab_by_ptr(ptrs[i], &type)->heap_id == (i % 3 ? a : b)->id);
+    void *batch[64];
+    assert(sea_malloc_batch(48, 64, batch) == 64);
+    for (int i = 0; i < 64; i++)
+        assert(find_slab_by_ptr(batch[i], &type)->heap_id == 0);
+    sea_free_batch(batch, 64);
+
+    // A block that moves stays in its heap, and keeps its bytes
+    char *r = sea_heap_alloc(a, 24);
+    memset(r, 0x5a, 24);
+    r = sea_realloc(r, 5000);
+    assert(find_slab_by_ptr(r, &type)->heap_id == a->id && r[23] == 0x5a);
+    r = sea_realloc(r, 50000);
+    assert(find_slab_by_ptr(r, &type)->heap_id == a->id && type == 3);
+    assert(r[23] == 0x5a);
+    r = sea_realloc(r, 300000);
+    assert(find_slab_by_ptr(r, &type)->heap_id == a->id && r[23] == 0x5a);
+    r = sea_realloc(r, MEDIUM_BLOCK_MAX + 1);
+    assert(find_slab_by_ptr(r, &type)->heap_id == a->id && type == 2);
+    assert(r[23] == 0x5a);
+    // Up to medium_max, a heap block is a page run: no mapping of its own
+    uint64_t chunks = g_stats.medium_chunks;
+    for (int i = 0; i < 8; i++)
+        sea_free(sea_heap_alloc(a, 200000));
+    assert(g_stats.medium_chunks <= chunks + 1);
+
+    // Threads share a heap; its slabs are fed from g_heap's empties first
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++)
+        pthread_create(&threads[i], NULL, heap_worker, b);
+    for (int i = 0; i < 4; i++)
+        pthread_join(threads[i], NULL);
+
+    // One sweep frees a: b's blocks are left alone
+    sea_heap_destroy(a);
+    for (int i = 0; i < 3000; i += 3)
+        if (i % 4 && (i % 8) != 1)
+            for (size_t j = 0; j < sizes[i]; j += 512)
+                assert(((unsigned char *)ptrs[i])[j] == (i & 0xff));
+    sea_heap_destroy(b);
+    sea_heap_destroy(NULL);
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++)
+        assert(g_heap.empty_count[i] <= SLAB_KEEP_EMPTY);
+
+    // Nothing left behind: counters and slabs as before the heaps
+    sea_malloc_stats(&after);
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+        assert(after.classes[i].live == before.classes[i].live);
+        assert(after.classes[i].spans <= before.classes[i].spans + SLAB_KEEP_EMPTY);
+    }
+    assert(after.medium.live == before.medium.live);
+    assert(after.large.live == before.large.live);
+    assert(g_heaps.live == 0);
+
+    // The sweep walks on past runs that merged with free neighbours
+    t_sea_heap *d = sea_heap_create();
+    void *runs[6];
+    for (int i = 0; i < 6; i++)
+        runs[i] = sea_heap_alloc(d, 64 * 1024);
+    sea_free(runs[1]);
+    sea_free(runs[4]);
+    sea_heap_destroy(d);
+    for (int i = 0; i < 6; i++)
+        assert(find_slab_by_ptr(runs[i], NULL) == NULL);
+
+    // Ids are reused, a NULL heap is g_heap
+    t_sea_heap *c = sea_heap_create();
+    assert(c && c->id <= 2);
+    void *g = sea_heap_alloc(NULL, 64);
+    assert(find_slab_by_ptr(g, &type)->heap_id == 0);
+    sea_free(g);
+    sea_heap_destroy(c);
+
+    printf("  ✅ Heaps come and go in one sweep!\n");
+}
+
+// "hg" in the VmFlags of the mapping holding ptr: advised MADV_HUGEPAGE
+static int advised_huge(void *ptr)
+{
+    char line[512];
+    int inside = 0;
+    int huge = -1;
+    FILE *f = fopen("/proc/self/smaps", "r");
+
+    assert(f != NULL);
+    while (huge < 0 && fgets(line, sizeof(line), f))
+    {
+        unsigned long lo, hi;
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2)
+            inside = (uintptr_t)ptr >= lo && (uintptr_t)ptr < hi;
+        else if (inside && !strncmp(line, "VmFlags:", 8))
+            huge = strstr(line, " hg") != NULL;
+    }
+    fclose(f);
+    return (huge > 0);
+}
+
+void test_transparent_huge_pages(void)
+{
+    printf("\n🔹 TEST 29: Transparent huge pages\n");
+
+    static void *ptrs[2000];
+    int aligned_1m = 0;
+    int aligned_2m = 0;
+    t_slab *last = NULL;
+
+    // 1 MB zones carved two to a 2 MB region (retained zones from
+    // before are let go first: they were mapped without the advice)
+    reclaim_remote();
+    slab_decay(true);
+    sea_malloc_thp(true);
+    for (int i = 0; i < 2000; i++)
+    {
+        ptrs[i] = sea_malloc(2500);
+        t_slab *slab = find_slab_by_ptr(ptrs[i], NULL);
+        if (slab == last)
+            continue;
+        last = slab;
+        aligned_1m += ((uintptr_t)slab % (1024 * 1024)) == 0;
+        if (((uintptr_t)slab % THP_SIZE) == 0)
+        {
+            aligned_2m++;
+            assert(advised_huge(slab));
+        }
+    }
+    assert(aligned_1m >= 3 && aligned_2m >= 1);
+
+    // LARGE from THP_SIZE up (too big to be cached): header on a huge
+    // page boundary
+    char *big = sea_malloc(40 * 1024 * 1024);
+    assert(((uintptr_t)(big - sizeof(t_slab)) % THP_SIZE) == 0);
+    assert(advised_huge(big));
+    memset(big, 0x42, 40 * 1024 * 1024);
+    big = sea_realloc(big, 48 * 1024 * 1024);
+    assert(big[40 * 1024 * 1024 - 1] == 0x42);
+    void *small_large = sea_malloc(1024 * 1024);
+    assert(small_large && !advised_huge(small_large));
+
+    sea_malloc_thp(false);
+    for (int i = 0; i < 2000; i++)
+        sea_free(ptrs[i]);
+    sea_free(big);
+    sea_free(small_large);
+
+    printf("  ✅ Zones and big blocks sit on huge pages!\n");
+}
+
+// Resident pages strictly between kept blocks 64 apart in the same zone
+static size_t resident_gaps(void **ptrs, int count, size_t size)
+{
+    size_t total = 0;
+
+    for (int i = 0; i + 64 < count; i += 64)
+    {
+        char *from = (char *)ptrs[i] + size;
+        char *to = ptrs[i + 64];
+        if (to - from != (ptrdiff_t)(63 * class_to_size(size_to_class(size))
+                                     + class_to_size(size_to_class(size)) - size))
+            continue;
+        from = (char *)(((uintptr_t)from + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1));
+        to = (char *)((uintptr_t)to & ~(uintptr_t)(PAGE_SIZE - 1));
+        if (to > from)
+            total += resident_pages(from, to - from);
+    }
+    return (total);
+}
+
+void test_trim_and_purge(void)
+{
+    printf("\n🔹 TEST 30: Trim and background purge\n");
+
+    static void *ptrs[4096];
+    void *runs[20];
+
+    // A spike of 2000 B blocks, one in 64 still live afterwards
+    for (int i = 0; i < 4096; i++)
+    {
+        ptrs[i] = sea_malloc(2000);
+        memset(ptrs[i], 1, 2000);
+    }
+    for (int i = 0; i < 4096; i++)
+        if (i % 64)
+            sea_free(ptrs[i]);
+    // MEDIUM runs every other one freed, a LARGE block in the cache
+    for (int i = 0; i < 20; i++)
+    {
+        runs[i] = sea_malloc(100 * 1024);
+        memset(runs[i], 2, 100 * 1024);
+    }
+    for (int i = 0; i < 20; i += 2)
+        sea_free(runs[i]);
+    void *big = sea_malloc(3 * 1024 * 1024);
+    memset(big, 3, 3 * 1024 * 1024);
+    sea_free(big);
+    size_t before = resident_gaps(ptrs, 4096, 2000);
+    assert(before > 500);
+    assert(g_heap.cache_bytes >= 3 * 1024 * 1024);
+
+    // pad keeps that much LARGE cache, the rest goes
+    assert(sea_malloc_trim(64 * 1024 * 1024) == 1);
+    assert(g_heap.cache_bytes >= 3 * 1024 * 1024);
+    assert(resident_gaps(ptrs, 4096, 2000) < before / 16);
+    for (int i = 0; i < 20; i += 2)
+        assert(resident_pages(runs[i], 100 * 1024) == 0);
+    for (int i = 1; i < 20; i += 2)
+        assert(resident_pages(runs[i], 100 * 1024) == 25);
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++)
+        assert(g_heap.empty_count[i] == 0 && g_heap.empty[i] == NULL);
+    // Nothing new since: pages already purged don't count twice
+    assert(sea_malloc_trim(64 * 1024 * 1024) == 0);
+    sea_malloc_trim(0);
+    assert(g_heap.cache_bytes == 0);
+
+    // Live data is untouched, freed pages come back as zeros
+    for (int i = 0; i < 4096; i += 64)
+        assert(((unsigned char *)ptrs[i])[1999] == 1);
+    for (int i = 1; i < 20; i += 2)
+        assert(((unsigned char *)runs[i])[100 * 1024 - 1] == 2);
+    void *again = sea_calloc(1, 100 * 1024);
+    assert(again && all_zero(again, 100 * 1024));
+    sea_free(again);
+
+    // The purge thread does the page pass on its own
+    assert(!sea_malloc_purge_start(0));
+    assert(sea_malloc_purge_start(10));
+    assert(sea_malloc_purge_start(20));
+    for (int i = 0; i < 4096; i++)
+        if (i % 64)
+        {
+            ptrs[i] = sea_malloc(2000);
+            memset(ptrs[i], 1, 2000);
+        }
+    for (int i = 0; i < 4096; i++)
+        if (i % 64)
+            sea_free(ptrs[i]);
+    before = resident_gaps(ptrs, 4096, 2000);
+    for (int tries = 0; tries < 100 && resident_gaps(ptrs, 4096, 2000) > before / 16; tries++)
+        usleep(10000);
+    assert(resident_gaps(ptrs, 4096, 2000) <= before / 16);
+    sea_malloc_purge_stop();
+    sea_malloc_purge_stop();
+
+    for (int i = 0; i < 4096; i += 64)
+        sea_free(ptrs[i]);
+    for (int i = 1; i < 20; i += 2)
+        sea_free(runs[i]);
+
+    printf("  ✅ Free pages go back, live ones stay!\n");
+}
+
+void test_runtime_tuning(void)
+{
+    printf("\n🔹 TEST 31: Runtime tuning (sea_mallctl, KRAKEN_MALLOC_CONF)\n");
+
+    size_t old;
+    size_t val;
+    int type;
+
+    // Defaults are the header's constants
+    assert(sea_mallctl("small_max", &old, NULL) == 0 && old == SMALL_BLOCK_MAX);
+    assert(sea_mallctl("large_cache", &old, NULL) == 0 && old == LARGE_CACHE_BYTES);
+    assert(sea_mallctl("tcache_max", &old, NULL) == 0 && old == TCACHE_MAX_SIZE);
+    assert(sea_mallctl("nope", &old, NULL) == ENOENT);
+    val = 4096;
+    assert(sea_mallctl("small_max", NULL, &val) == EPERM);
+    val = 0;
+    assert(sea_mallctl("tcache_bin", NULL, &val) == EINVAL);
+    val = 2048;
+    assert(sea_mallctl("tcache_max", NULL, &val) == EINVAL);
+
+    // tcache_max rounds down to a class
+    val = 100;
+    assert(sea_mallctl("tcache_max", &old, &val) == 0);
+    assert(sea_mallctl("tcache_max", &val, NULL) == 0 && val == 96);
+    assert(sea_mallctl("tcache_max", NULL, &old) == 0);
+
+    // Lowered, the bins past it go back on this thread's next access
+    int c512 = size_to_class(512);
+    sea_free(sea_malloc(512));
+    reclaim_remote();
+    assert(g_heap.remote[c512].head == NULL);
+    val = 256;
+    assert(sea_mallctl("tcache_max", &old, &val) == 0);
+    assert(g_heap.remote[c512].head == NULL);
+    sea_free(sea_malloc(16));
+    assert(g_heap.remote[c512].head != NULL);
+    assert(sea_mallctl("tcache_max", NULL, &old) == 0);
+
+    // MEDIUM / LARGE boundary moves at once
+    void *p = sea_malloc(100 * 1024);
+    assert(find_slab_by_ptr(p, &type) && type == 3);
+    val = 64 * 1024;
+    assert(sea_mallctl("medium_max", &old, &val) == 0);
+    void *q = sea_malloc(100 * 1024);
+    assert(find_slab_by_ptr(q, &type) && type == 2);
+    memset(q, 7, 100 * 1024);
+    q = sea_realloc(q, 110 * 1024);
+    assert(find_slab_by_ptr(q, &type) && type == 2);
+    assert(((unsigned char *)q)[100 * 1024 - 1] == 7);
+    p = sea_realloc(p, 90 * 1024);
+    assert(find_slab_by_ptr(p, &type) && type == 2);
+    assert(sea_mallctl("medium_max", NULL, &old) == 0);
+    sea_free(p);
+    sea_free(q);
+
+    // A smaller LARGE cache budget evicts right away
+    void *big = sea_malloc(3 * 1024 * 1024);
+    sea_free(big);
+    assert(g_heap.cache_bytes >= 3 * 1024 * 1024);
+    val = 4 * 1024 * 1024;
+    assert(sea_mallctl("large_cache", &old, &val) == 0);
+    assert(g_heap.cache_bytes <= val);
+    big = sea_malloc(3 * 1024 * 1024);
+    sea_free(big);
+    assert(g_heap.cache_bytes <= val / 2);
+    assert(sea_mallctl("large_cache", NULL, &old) == 0);
+
+    // No retained empty zones
+    void *blocks[600];
+    int cls = size_to_class(3000);
+    sea_malloc_trim(0);
+    val = 0;
+    assert(sea_mallctl("slab_keep", &old, &val) == 0);
+    for (int i = 0; i < 600; i++)
+        blocks[i] = sea_malloc(3000);
+    sea_free_batch(blocks, 600);
+    assert(g_heap.empty_count[cls] == 0);
+    assert(sea_mallctl("slab_keep", NULL, &old) == 0);
+
+    // Purge thread and huge pages through the same door
+    val = 50;
+    assert(sea_mallctl("purge_ms", NULL, &val) == 0);
+    assert(sea_mallctl("purge_ms", &old, NULL) == 0 && old == 50);
+    val = 0;
+    assert(sea_mallctl("purge_ms", NULL, &val) == 0);
+    assert(sea_mallctl("purge_ms", &old, NULL) == 0 && old == 0);
+    val = 1;
+    assert(sea_mallctl("thp", NULL, &val) == 0 && g_thp.on);
+    val = 0;
+    assert(sea_mallctl("thp", NULL, &val) == 0 && !g_thp.on);
+
+    // The environment string, read again in a child as on first use
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        setenv("KRAKEN_MALLOC_CONF", "bogus:1,small_max:512,tcache_bin:0,"
+               "tiny_zone:5000,small_zone:256k,large_cache:8m,decay_ms,"
+               "medium_keep:3x,slab_keep:4", 1);
+        g_conf.ready = 0;
+        g_conf.booting = 0;
+        dup2(open("/dev/null", O_WRONLY), 2); // the four bad items
+        conf_init();
+        int ok = g_conf.small_max == 512 && g_conf.tcache_max == 512
+            && g_conf.tcache_bin == TCACHE_BIN_MAX && g_conf.tiny_zone == 8192
+            && g_conf.small_zone == 256 * 1024
+            && g_conf.large_cache == 8 * 1024 * 1024
+            && g_conf.decay_ms == SLAB_DECAY_MS
+            && g_conf.medium_keep == MEDIUM_KEEP_CHUNKS && g_conf.slab_keep == 4
+            && class_zone_size(size_to_class(8192)) == 256 * 1024;
+        // Past small_max: a page run, freed by size like any other
+        void *m = sea_malloc(600);
+        ok = ok && find_slab_by_ptr(m, &type) && type == 3;
+        m = sea_realloc(m, 700);
+        ok = ok && find_slab_by_ptr(m, &type) && type == 3;
+        sea_free_sized(m, 700);
+        _exit(ok ? 0 : 1);
+    }
+    int status;
+    assert(pid > 0 && waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // The older variables are options too, KRAKEN_MALLOC_CONF has the last word
+    pid = fork();
+    if (pid == 0)
+    {
+        // no purge thread here: threads and fork children don't mix
+        setenv("KRAKEN_MALLOC_THP", "1", 1);
+        setenv("KRAKEN_MALLOC_PURGE_MS", "50x", 1);
+        unsetenv("KRAKEN_MALLOC_CONF");
+        g_conf.ready = 0;
+        g_conf.booting = 0;
+        dup2(open("/dev/null", O_WRONLY), 2); // the bad interval
+        conf_init();
+        int ok = g_thp.on && sea_mallctl("purge_ms", &old, NULL) == 0 && old == 0;
+        setenv("KRAKEN_MALLOC_CONF", "thp:0", 1);
+        g_conf.ready = 0;
+        g_conf.booting = 0;
+        conf_init();
+        ok = ok && !g_thp.on;
+        _exit(ok ? 0 : 1);
+    }
+    assert(pid > 0 && waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    printf("  ✅ Tunables read, set and parsed!\n");
+}
+
+void test_reserve(void)
+{
+    printf("\n🔹 TEST 32: Pre-reserved zones\n");
+
+    static void *blocks[1000];
+    t_reserve_stats rs;
+    t_malloc_stats st;
+
+    assert(sea_malloc_reserve(0, 10) == 0);
+    assert(sea_malloc_reserve(SMALL_BLOCK_MAX + 1, 10) == 0);
+    assert(!sea_malloc_reserve_stats(SMALL_BLOCK_MAX + 1, &rs));
+
+    // Mapped and faulted in up front
+    sea_malloc_trim(0);
+    size_t n = sea_malloc_reserve(3000, 1000);
+    assert(n >= 1000);
+    assert(sea_malloc_reserve(3000, 10) == n); // only ever grows
+    assert(sea_malloc_reserve_stats(3000, &rs));
+    assert(rs.blocks == n && rs.free == n && rs.slabs >= 3);
+    assert(rs.resident == rs.mapped);
+
+    // The phase itself: no mmap, and the zones stay when emptied
+    sea_malloc_stats(&st);
+    uint64_t mmaps = st.mmap_calls;
+    for (int i = 0; i < 1000; i++)
+    {
+        blocks[i] = sea_malloc(3000);
+        memset(blocks[i], 5, 3000);
+    }
+    sea_malloc_stats(&st);
+    assert(st.mmap_calls == mmaps);
+    assert(sea_malloc_reserve_stats(3000, &rs));
+    assert(rs.blocks == n && rs.free <= n - 1000);
+    for (int i = 0; i < 1000; i++)
+        sea_free(blocks[i]);
+
+    // Decay, trim and the purge pass leave the reserve alone
+    slab_decay(true);
+    sea_malloc_trim(0);
+    assert(sea_malloc_reserve_stats(3000, &rs));
+    assert(rs.blocks == n && rs.free == n && rs.resident == rs.mapped);
+    assert(g_heap.reserve[size_to_class(3000)] != NULL);
+
+    // Dropped: back to ordinary empty zones
+    assert(sea_malloc_reserve(3000, 0) == 0);
+    assert(sea_malloc_reserve_stats(3000, &rs) && rs.slabs == 0 && rs.blocks == 0);
+    assert(g_heap.reserve[size_to_class(3000)] == NULL);
+    assert(g_heap.empty_count[size_to_class(3000)] <= SLAB_KEEP_EMPTY);
+
+    printf("  ✅ Reserved zones stay mapped, faulted in and pinned!\n");
+}
+
+typedef struct s_walk_check
+{
+    void    *want[5];
+    int     type[5];
+    size_t  size[5];
+    int     found[5];
+    void    *gone;
+    int     gone_seen;
+    size_t  seen;
+    size_t  limit;
+    bool    allocate;
+}   t_walk_check;
+
+static bool walk_check(const t_malloc_block *block, void *ctx)
+{
+    t_walk_check *c = ctx;
+
+    for (int i = 0; i < 5; i++)
+        if (block->ptr == c->want[i])
+        {
+            assert(block->type == c->type[i] && block->size == c->size[i]);
+            assert((block->class_idx >= 0) == (block->type < 2));
+            c->found[i]++;
+        }
+    c->gone_seen += (block->ptr == c->gone);
+    // a snapshot's callback may use the allocator
+    if (c->allocate)
+        sea_free(sea_malloc(3000));
+    return (++c->seen < c->limit);
+}
+
+void test_heap_walk(void)
+{
+    printf("\n🔹 TEST 33: Heap walk (sea_malloc_iterate)\n");
+
+    t_walk_check c;
+    t_sea_heap *heap = sea_heap_create();
+
+    memset(&c, 0, sizeof(c));
+    c.want[0] = sea_malloc(24);      c.type[0] = 0; c.size[0] = 32;
+    c.want[1] = sea_malloc(3000);    c.type[1] = 1; c.size[1] = class_to_size(size_to_class(3000));
+    c.want[2] = sea_malloc(100000);  c.type[2] = 3; c.size[2] = 100000;
+    c.want[3] = sea_malloc(1 << 20); c.type[3] = 2; c.size[3] = 1 << 20;
+    c.want[4] = sea_heap_alloc(heap, 200); c.type[4] = 1; c.size[4] = 224;
+    // freed blocks, through the thread cache or the remote list, don't show
+    c.gone = sea_malloc(24);
+    sea_free(c.gone);
+    c.limit = (size_t)-1;
+
+    size_t live = sea_malloc_iterate(walk_check, &c, 0);
+    for (int i = 0; i < 5; i++)
+        assert(c.found[i] == 1);
+    assert(c.gone_seen == 0 && live == c.seen && live >= 5);
+
+    memset(c.found, 0, sizeof(c.found));
+    c.seen = 0;
+    c.allocate = true;
+    size_t snap = sea_malloc_iterate(walk_check, &c, SEA_MALLOC_SNAPSHOT);
+    for (int i = 0; i < 5; i++)
+        assert(c.found[i] == 1);
+    assert(snap == live);
+
+    // false stops the walk
+    c.allocate = false;
+    c.seen = 0;
+    c.limit = 3;
+    assert(sea_malloc_iterate(walk_check, &c, 0) == 3);
+    c.seen = 0;
+    assert(sea_malloc_iterate(walk_check, &c, SEA_MALLOC_SNAPSHOT) == 3);
+    assert(sea_malloc_iterate(NULL, NULL, 0) == 0);
+
+    for (int i = 0; i < 4; i++)
+        sea_free(c.want[i]);
+    sea_heap_destroy(heap);
+
+    printf("  ✅ Every live block, once, with or without the locks!\n");
+}
+
+int main(void)
+{
+    printf("\n");
+    printf("🐙 ============================================== 🐙\n");
+    printf("       KRAKENLIB MALLOC COMPREHENSIVE TESTS\n");
+    printf("🐙 ============================================== 🐙\n");
+
+    test_basic_allocations();
+    test_zone_boundaries();
+    test_zero_and_null();
+    test_realloc();
+    test_calloc();
+    test_fragmentation();
+    test_large_allocations();
+    test_stress();
+    test_original_demo();
+    test_threads();
+    test_large_realloc_and_foreign();
+    test_medium();
+    test_size_classes();
+    test_partial_full_lists();
+    test_empty_slab_retention();
+    test_large_cache();
+    test_large_realloc_in_place();
+    test_usable_size_and_aligned();
+    test_slab_alignment();
+    test_remote_free();
+    test_per_class_locks();
+    test_sized_and_batch();
+    test_zero_aware_calloc();
+    test_stats();
+    test_heap_profiler();
+    test_allocation_trace();
+    test_explicit_heaps();
+    test_transparent_huge_pages();
+    test_trim_and_purge();
+    test_runtime_tuning();
+    test_reserve();
+    test_heap_walk();
+
+    printf("\n");
+    printf("🐙 ============================================== 🐙\n");
+    printf("       🎉 ALL MALLOC TESTS PASSED! 🎉\n");
+    printf("       The Kraken's memory is UNLEASHED!\n");
+    printf("🐙 ============================================== 🐙\n");
+    printf("\n");
+
+    return 0;
+}
@@ -18,7 +18,7 @@
 /*      Filename: test.c                                                      */
 /*      By: espadara <espadara@pirate.capn.gg>                                */
 /*      Created: 2025/08/27 22:40:24 by espadara                              */
-/*      Updated: 2025/11/13 00:20:19 by espadara                              */
+/*      Updated: 2026/10/17 18:55:18 by espadara                              */
 /*                                                                            */
 /* ************************************************************************** */
 
@@ -825,6 +825,30 @@ puts("\n---STRCMP---");
                (memcmp(real_dest, seal_dest, sizeof(real_dest)) == 0) ? "OK" : "FAIL");
     }
   }
+  puts("\n---BZERO_FAST---");
+  {
+    size_t sizes[] = {0, 1, 15, 16, 17, 31, 63, 64, 65, 100, 1000, 4099};
+    int num_tests = sizeof(sizes) / sizeof(sizes[0]);
+
+    for (int i = 0; i < num_tests; i++)
+    {
+        // every misalignment of the start, guard bytes on both sides
+        int ok = 1;
+        for (size_t off = 0; off < 16; off++)
+        {
+            unsigned char real_buf[4200];
+            unsigned char seal_buf[4200];
+            memset(real_buf, 0xAA, sizeof(real_buf));
+            memset(seal_buf, 0xAA, sizeof(seal_buf));
+            bzero(real_buf + 32 + off, sizes[i]);
+            sea_bzero_fast(seal_buf + 32 + off, sizes[i]);
+            if (memcmp(real_buf, seal_buf, sizeof(real_buf)) != 0)
+                ok = 0;
+        }
+        printf("Test: bzero_fast(buf, %zu) all offsets -> %s\n", sizes[i],
+               ok ? "OK" : "FAIL");
+    }
+  }
   puts("\n---STRDUP (HEAP)---");
   {
     // A structure to hold the test cases